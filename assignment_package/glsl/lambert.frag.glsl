@@ -116,6 +116,18 @@ vec3 waterNormalDisplacement(vec2 uv){
     return vec3(grad.xy, z);
 }
 
+// Chunk faces may span several blocks (see greedy meshing). For those,
+// fs_Col.xy counts blocks across the face and fs_Col.w is the atlas tile
+// index + 1, so the tile is repeated once per block rather than stretched
+// over the face.
+vec2 atlasUV() {
+    if (fs_Col.w < 0.5) {
+        return fs_UV;
+    }
+    int tile = int(fs_Col.w + 0.5) - 1;
+    return (vec2(tile % 16, tile / 16) + fract(fs_Col.xy)) * 0.0625;
+}
+
 void coordinateSystem(in vec3 nor, out vec3 tan, out vec3 bit){
     if (abs(nor.x) > abs(nor.y)){
         tan = vec3(-nor.z, 0, nor.x);
@@ -139,6 +151,8 @@ void coordinateSystem(in vec3 nor, out vec3 tan, out vec3 bit){
 
 void main()
 {
+    vec2 uv = atlasUV();
+
     // time loop for a day
     // -1 < t < -0.3 night
     // -0.3 < t < 0.3 sunset / sunrise
@@ -150,8 +164,8 @@ void main()
     // Direction of sun light
     vec3 sunDir = normalize(vec3(cos(u_Time * SUN_VELOCITY + TIME_OFFSET), sin(u_Time * SUN_VELOCITY + TIME_OFFSET), 0.f));
 
-    if (fs_Nor.w != 0.5 && !(fs_UV.x >= 14.f * 0.0625 && fs_UV.x < 15.f * 0.0625
-                             && fs_UV.y >= 2.f * 0.0625 && fs_UV.y < 3.f * 0.0625)){
+    if (fs_Nor.w != 0.5 && !(uv.x >= 14.f * 0.0625 && uv.x < 15.f * 0.0625
+                             && uv.y >= 2.f * 0.0625 && uv.y < 3.f * 0.0625)){
         time = sin(TIME_OFFSET);
         sunDir = normalize(vec3(cos(0 * SUN_VELOCITY + TIME_OFFSET), sin(0 * SUN_VELOCITY + TIME_OFFSET), 0.f));
     }
@@ -183,13 +197,13 @@ void main()
     //animation
     if (fs_Nor.w == 0.5){
         if (fs_Col.z == 0.2){
-            diffuseColor = texture(u_textureBetter, fs_UV);
+            diffuseColor = texture(u_textureBetter, uv);
             Nor = texture(u_normTexture, vec2(3 * 0.0625, 15 * 0.0625));
         }
         else{
-            diffuseColor = texture(u_texture, fs_UV);
+            diffuseColor = texture(u_texture, uv);
             diffuseColor.xyz = diffuseColor.xyz * (0.5 * fbm(fs_Pos.xyz) + 0.5);
-            Nor = texture(u_normTexture, fs_UV);
+            Nor = texture(u_normTexture, uv);
         }
 
 //        vec4 my_Nor = texture(u_normTexture, fs_UV);
@@ -198,13 +212,13 @@ void main()
     } else{
         if (fs_Col.z == 0.2){
 
-            diffuseColor = texture(u_textureBetter, vec2(fs_UV.x + (u_Time % 10) * 0.01 * 0.0625, fs_UV.y));
+            diffuseColor = texture(u_textureBetter, vec2(uv.x + (u_Time % 10) * 0.01 * 0.0625, uv.y));
             Nor = texture(u_normTexture, vec2(3 * 0.0625, 15 * 0.0625));
 //            diffuseColor.xyz = diffuseColor.xyz * (0.5 * fbm(fs_Pos.xyz) + 0.5);
         }
         else{
-            if (fs_UV.x >= 14.f * 0.0625 && fs_UV.x < 15.f * 0.0625
-                    && fs_UV.y >= 2.f * 0.0625 && fs_UV.y < 3.f * 0.0625){
+            if (uv.x >= 14.f * 0.0625 && uv.x < 15.f * 0.0625
+                    && uv.y >= 2.f * 0.0625 && uv.y < 3.f * 0.0625){
                 vec3 tan, bit;
                 coordinateSystem(normalize(fs_Nor.xyz), tan, bit);
                 mat3 tanWorld = mat3(tan, bit, normalize(fs_Nor.xyz));
@@ -213,9 +227,9 @@ void main()
                 Nor = vec4(shadingNormal.x, shadingNormal.y, shadingNormal.z,  0.f);
 //                diffuseColor = texture(u_texture, vec2(floor(fs_UV.x * 4.f) / 4.f, floor(fs_UV.y * 4.f) / 4.f));
 //                diffuseColor = vec4(0);
-                diffuseColor = texture(u_texture, vec2(fs_UV.x + (u_Time % 20) * 0.05 * 0.0625, fs_UV.y));
+                diffuseColor = texture(u_texture, vec2(uv.x + (u_Time % 20) * 0.05 * 0.0625, uv.y));
             }else{
-                diffuseColor = texture(u_texture, vec2(fs_UV.x + (u_Time % 20) * 0.05 * 0.0625, fs_UV.y));
+                diffuseColor = texture(u_texture, vec2(uv.x + (u_Time % 20) * 0.05 * 0.0625, uv.y));
                 diffuseColor.rgb = diffuseColor.rgb * (0.5 * fbm(fs_Pos.xyz) + 0.5);
                 Nor = texture(u_normTexture, vec2(3 * 0.0625, 15 * 0.0625));
             }
@@ -24,13 +24,11 @@ uniform vec4 u_Color;       // When drawing the cube instance, we'll set our uni
 
 uniform int u_Time;
 
-in vec4 vs_UV;
+uniform isamplerBuffer u_ChunkOrigins; // The X and Z of the Chunk that owns each 64 vertices of the
+                                       // MeshArena page being drawn. 64 is MeshArena::BLOCK_GRANULARITY.
 
-in vec4 vs_Pos;             // The array of vertex positions passed to the shader
-
-in vec4 vs_Nor;             // The array of vertex normals passed to the shader
-
-in vec4 vs_Col;             // The array of vertex colors passed to the shader.
+in uvec2 vs_Packed;         // One packed Chunk vertex. See PackedVertex in chunksection.h
+                            // for the bit layout.
 
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
@@ -41,11 +39,39 @@ out vec2 fs_UV;
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
 
+// Indexed by the Direction enum in chunk.h
+const vec3 faceNormals[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0),
+                                   vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+// Indexed by the FaceInset enum in chunksection.h
+const float faceInsets[4] = float[](0.0, 0.1, 0.2, 0.5);
+// The VertexFlags enum in chunksection.h
+const uint VERTEX_BETTER_TEXTURE = 1u;
+const uint VERTEX_NO_NORMAL = 2u;
+const uint VERTEX_ANIMATED = 4u;
+
 void main()
 {
+    // Unpack the vertex
+    uint posDir = vs_Packed.x;
+    uint texFlags = vs_Packed.y;
+    uint flags = texFlags >> 18;
+    vec3 normal = faceNormals[(posDir >> 19) & 7u];
+    vec4 vs_Pos = vec4(float(posDir & 31u), float((posDir >> 5) & 511u), float((posDir >> 14) & 31u), 1);
+    vs_Pos.xyz -= normal * faceInsets[(posDir >> 22) & 3u];
+    vs_Pos.y -= 0.5 * float((posDir >> 24) & 1u);
+    // The vertex is relative to its Chunk; gl_VertexID includes the base
+    // vertex, so it is also the vertex's index in the page
+    vs_Pos.xz += vec2(texelFetch(u_ChunkOrigins, gl_VertexID / 64).xy);
+    vec4 vs_Nor = vec4(normal, (flags & VERTEX_NO_NORMAL) != 0u ? 0 : 0.5);
+    // u and v count blocks across the face; the fragment shader turns them
+    // into atlas coordinates inside the tile stored in w
+    vec2 blockUV = vec2(float(texFlags & 31u), float((texFlags >> 5) & 31u));
+    uint tile = (texFlags >> 10) & 255u;
+    vec4 vs_Col = vec4(blockUV, (flags & VERTEX_BETTER_TEXTURE) != 0u ? 0.2 : 0, float(tile + 1u));
+
     fs_Pos = u_Model * vs_Pos;
     fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
-    fs_UV = vs_Col.xy;
+    fs_UV = (vec2(tile % 16u, tile / 16u) + blockUV) * 0.0625;
 
     mat3 invTranspose = mat3(u_ModelInvTr);
     fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
@@ -70,8 +96,7 @@ void main()
         float h = 0.25f * (hz - 1.f + hx - 1.f);
         modelposition.y += h;
     }
-    if (fs_UV.x >= 15.f * 0.0625 && fs_UV.x < 16.f * 0.0625
-                        && fs_UV.y >= 14.f * 0.0625 && fs_UV.y < 15.f * 0.0625){
+    if ((flags & VERTEX_ANIMATED) != 0u){
         float tx = modelposition.x * 0.1 + u_Time / 10.f;
         float tz = modelposition.z * 0.1 + u_Time / 10.f;
         float hx = (sin(1.5f * tx) + sin(2.6 * tx + 6.f) +
@@ -0,0 +1,794 @@
+#include "benchmark.h"
+#include "scene/terrain.h"
+#include "scene/noisebatch.h"
+#include "scene/biomes.h"
+#include "scene/cavedensity.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+// Side length, in Chunks, of the square of generated terrain the benchmarks run on.
+// Only the inner (GRID - 2) x (GRID - 2) Chunks are measured so that
+// every measured Chunk has all four neighbors.
+static const int GRID = 6;
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Queues each Chunk's m_spilled on its neighbors in a side x side square
+// of Chunks, as updateTerrian() does once a Chunk is decorated
+static void handOnSpills(std::vector<uPtr<Chunk>> &chunks, int side) {
+    for (int n = 0; n < side * side; n++) {
+        int i = n / side, j = n % side;
+        for (int k = 0; k < 9; k++) {
+            int ni = i + k % 3 - 1, nj = j + k / 3 - 1;
+            if (ni >= 0 && nj >= 0 && ni < side && nj < side) {
+                chunks[ni * side + nj]->queueWrites(std::move(chunks[n]->m_spilled[k]));
+            }
+            chunks[n]->m_spilled[k].clear();
+        }
+    }
+}
+
+static std::vector<uPtr<Chunk>> generateGrid(Terrain &terrain) {
+    std::vector<uPtr<Chunk>> chunks;
+    for (int i = 0; i < GRID; i++) {
+        for (int j = 0; j < GRID; j++) {
+            chunks.push_back(mkU<Chunk>(nullptr, 16 * i, 16 * j));
+        }
+    }
+    for (int i = 0; i < GRID; i++) {
+        for (int j = 0; j < GRID; j++) {
+            if (i + 1 < GRID) {
+                chunks[i * GRID + j]->linkNeighbor(chunks[(i + 1) * GRID + j], XPOS);
+            }
+            if (j + 1 < GRID) {
+                chunks[i * GRID + j]->linkNeighbor(chunks[i * GRID + j + 1], ZPOS);
+            }
+        }
+    }
+    // Both phases, each once every Chunk has finished the one before
+    for (uPtr<Chunk> &chunk : chunks) {
+        terrain.fillChunk(chunk.get());
+    }
+    for (uPtr<Chunk> &chunk : chunks) {
+        terrain.decorateChunk(chunk.get());
+        chunk->compactBlocks();
+    }
+    handOnSpills(chunks, GRID);
+    for (uPtr<Chunk> &chunk : chunks) {
+        chunk->applyPendingWrites();
+    }
+    return chunks;
+}
+
+static bool isInterior(int n) {
+    int i = n / GRID, j = n % GRID;
+    return i > 0 && j > 0 && i < GRID - 1 && j < GRID - 1;
+}
+
+static bool hidesFace(BlockType t) {
+    return !blockProperties(t).has(BLOCK_TRANSPARENT);
+}
+
+// The face visibility pass as it was written before meshing went through
+// a SectionSnapshot: a neighbor Chunk lookup and bounds-checked
+// getBlockAt() for every face of every block.
+static int countFacesWithLookups(Chunk &chunk, int section) {
+    static const std::array<glm::ivec3, 6> dirs {
+        glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 1, 0),
+        glm::ivec3(0, -1, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+    };
+    int faces = 0;
+    for (int z = 0; z < 16; z++) {
+        for (int y = 16 * section; y < 16 * section + 16; y++) {
+            for (int x = 0; x < 16; x++) {
+                if (chunk.getBlockAt(x, y, z) == EMPTY) {
+                    continue;
+                }
+                for (int d = 0; d < 6; d++) {
+                    glm::ivec3 n = glm::ivec3(x, y, z) + dirs[d];
+                    BlockType neighborType;
+                    if (n.x < 0 || n.x > 15 || n.z < 0 || n.z > 15) {
+                        Chunk *neighborChunk = chunk.m_neighbors[Direction(d)];
+                        neighborType = neighborChunk == nullptr ? EMPTY
+                                                                : neighborChunk->getBlockAt(n.x & 15, n.y, n.z & 15);
+                    } else {
+                        neighborType = chunk.getBlockAt(n.x, n.y, n.z);
+                    }
+                    faces += !hidesFace(neighborType);
+                }
+            }
+        }
+    }
+    return faces;
+}
+
+// The same pass over a padded SectionSnapshot
+static int countFacesWithSnapshot(Chunk &chunk, int section, SectionSnapshot &snapshot) {
+    static const std::array<int, 6> offsets {
+        1, -1, SectionSnapshot::SIZE, -SectionSnapshot::SIZE,
+        SectionSnapshot::SIZE * SectionSnapshot::SIZE, -SectionSnapshot::SIZE * SectionSnapshot::SIZE
+    };
+    chunk.copySection(section, snapshot);
+    int faces = 0;
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 16; y++) {
+            int i = SectionSnapshot::index(0, y, z);
+            for (int x = 0; x < 16; x++, i++) {
+                if (snapshot.blocks[i] == EMPTY) {
+                    continue;
+                }
+                for (int offset : offsets) {
+                    faces += !hidesFace(snapshot.blocks[i + offset]);
+                }
+            }
+        }
+    }
+    return faces;
+}
+
+static void benchmarkFaceVisibility(std::vector<uPtr<Chunk>> &chunks) {
+    SectionSnapshot snapshot;
+    long long facesLookup = 0, facesSnapshot = 0;
+    int measured = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < (int)chunks.size(); n++) {
+        if (isInterior(n)) {
+            for (int s = 0; s < 16; s++) {
+                facesLookup += countFacesWithLookups(*chunks[n], s);
+            }
+            measured++;
+        }
+    }
+    double lookupMs = msSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < (int)chunks.size(); n++) {
+        if (isInterior(n)) {
+            for (int s = 0; s < 16; s++) {
+                facesSnapshot += countFacesWithSnapshot(*chunks[n], s, snapshot);
+            }
+        }
+    }
+    double snapshotMs = msSince(start);
+
+    std::cout << "Face visibility (" << measured << " chunks)" << std::endl;
+    std::cout << "  neighbor lookups: " << lookupMs / measured << " ms/chunk, "
+              << facesLookup << " faces" << std::endl;
+    std::cout << "  padded snapshot:  " << snapshotMs / measured << " ms/chunk, "
+              << facesSnapshot << " faces" << std::endl;
+}
+
+// The block property containers the mesher used before the blockProperties()
+// table, rebuilt from it so both passes below see the same data
+struct BlockPropertySets
+{
+    std::set<BlockType> transparentBlock, noNormal, usingBetterTexture, diagnalBlock;
+    std::unordered_map<BlockType, std::unordered_map<Direction, glm::vec2, EnumHash>, EnumHash> blockFaceUV;
+
+    BlockPropertySets() {
+        for (int i = 0; i < 256; i++) {
+            BlockType t = BlockType(i);
+            const BlockProperties &block = blockProperties(t);
+            if (block.shape == SHAPE_NONE && t != EMPTY) {
+                continue;
+            }
+            if (t != EMPTY && block.has(BLOCK_TRANSPARENT)) transparentBlock.insert(t);
+            if (block.has(BLOCK_LIQUID)) noNormal.insert(t);
+            if (block.has(BLOCK_BETTER_TEXTURE)) usingBetterTexture.insert(t);
+            if (block.shape == SHAPE_CROSS) diagnalBlock.insert(t);
+            for (int d = 0; d < 6; d++) {
+                blockFaceUV[t][Direction(d)] = glm::vec2(block.tiles[d] % 16, block.tiles[d] / 16) * float(BLK_UV);
+            }
+        }
+    }
+};
+
+// The property lookups the mesher makes for each face of each block:
+// is the neighbor see-through, which texture, which tile, which shape.
+// Returns a checksum so the work can't be optimized away.
+static long long lookUpWithSets(const BlockPropertySets &sets, const SectionSnapshot &snapshot) {
+    long long sum = 0;
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 16; y++) {
+            int i = SectionSnapshot::index(0, y, z);
+            for (int x = 0; x < 16; x++, i++) {
+                BlockType t = snapshot.blocks[i];
+                if (t == EMPTY) {
+                    continue;
+                }
+                for (const BlockFace &face : adjacentFaces) {
+                    BlockType n = snapshot.blocks[i + (face.direction == XPOS ? 1 : -1)];
+                    sum += n == EMPTY || sets.transparentBlock.find(n) != sets.transparentBlock.end();
+                    sum += sets.transparentBlock.find(t) != sets.transparentBlock.end();
+                    sum += sets.noNormal.find(t) != sets.noNormal.end();
+                    sum += sets.usingBetterTexture.find(t) != sets.usingBetterTexture.end();
+                    sum += sets.diagnalBlock.find(t) != sets.diagnalBlock.end();
+                    sum += int(sets.blockFaceUV.at(t).at(face.direction).x / BLK_UV);
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+static long long lookUpWithTable(const SectionSnapshot &snapshot) {
+    long long sum = 0;
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 16; y++) {
+            int i = SectionSnapshot::index(0, y, z);
+            for (int x = 0; x < 16; x++, i++) {
+                BlockType t = snapshot.blocks[i];
+                if (t == EMPTY) {
+                    continue;
+                }
+                const BlockProperties &block = blockProperties(t);
+                for (const BlockFace &face : adjacentFaces) {
+                    BlockType n = snapshot.blocks[i + (face.direction == XPOS ? 1 : -1)];
+                    sum += blockProperties(n).has(BLOCK_TRANSPARENT);
+                    sum += block.has(BLOCK_TRANSPARENT);
+                    sum += block.has(BLOCK_LIQUID);
+                    sum += block.has(BLOCK_BETTER_TEXTURE);
+                    sum += block.shape == SHAPE_CROSS;
+                    sum += block.tiles[face.direction] % 16;
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+static void benchmarkBlockProperties(std::vector<uPtr<Chunk>> &chunks) {
+    BlockPropertySets sets;
+    SectionSnapshot snapshot;
+    long long sumSets = 0, sumTable = 0;
+    double setsMs = 0, tableMs = 0;
+    int measured = 0;
+    for (int n = 0; n < (int)chunks.size(); n++) {
+        if (!isInterior(n)) {
+            continue;
+        }
+        for (int s = 0; s < 16; s++) {
+            chunks[n]->copySection(s, snapshot);
+            auto start = std::chrono::steady_clock::now();
+            sumSets += lookUpWithSets(sets, snapshot);
+            setsMs += msSince(start);
+            start = std::chrono::steady_clock::now();
+            sumTable += lookUpWithTable(snapshot);
+            tableMs += msSince(start);
+        }
+        measured++;
+    }
+    std::cout << "Block property lookups (" << measured << " chunks)" << std::endl;
+    std::cout << "  std::set / unordered_map: " << setsMs / measured << " ms/chunk, checksum " << sumSets << std::endl;
+    std::cout << "  constexpr table:          " << tableMs / measured << " ms/chunk, checksum " << sumTable << std::endl;
+}
+
+// Terrain::getBlockAt as it was before the ChunkGrid: hasChunkAt() and
+// getChunkAt() each floor a float division and probe the hash map
+static BlockType getBlockWithMap(const std::unordered_map<int64_t, uPtr<Chunk>> &chunks, int x, int y, int z) {
+    int xFloor = static_cast<int>(glm::floor(x / 16.f));
+    int zFloor = static_cast<int>(glm::floor(z / 16.f));
+    if (chunks.find(toKey(16 * xFloor, 16 * zFloor)) == chunks.end()) {
+        return EMPTY;
+    }
+    xFloor = static_cast<int>(glm::floor(x / 16.f));
+    zFloor = static_cast<int>(glm::floor(z / 16.f));
+    const uPtr<Chunk> &c = chunks.at(toKey(16 * xFloor, 16 * zFloor));
+    glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
+    return c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x), static_cast<unsigned int>(y),
+                         static_cast<unsigned int>(z - chunkOrigin.y));
+}
+
+static BlockType getBlockWithGrid(const ChunkGrid &grid, int x, int y, int z) {
+    const Chunk *c = grid.find(x >> 4, z >> 4);
+    return c == nullptr ? EMPTY : c->getBlockAt(x & 15, y, z & 15);
+}
+
+static void benchmarkChunkLookup(std::vector<uPtr<Chunk>> &generated) {
+    // Lay the generated Chunks out around the origin so the lookups
+    // cover negative coordinates too
+    std::unordered_map<int64_t, uPtr<Chunk>> chunks;
+    ChunkGrid grid;
+    for (int i = 0; i < GRID; i++) {
+        for (int j = 0; j < GRID; j++) {
+            int x = 16 * (i - GRID / 2), z = 16 * (j - GRID / 2);
+            uPtr<Chunk> chunk = mkU<Chunk>(nullptr, x, z);
+            for (int by = 0; by < 256; by++) {
+                for (int bz = 0; bz < 16; bz++) {
+                    for (int bx = 0; bx < 16; bx++) {
+                        chunk->setBlockAt(bx, by, bz, generated[i * GRID + j]->getBlockAt(bx, by, bz));
+                    }
+                }
+            }
+            chunk->compactBlocks();
+            grid.set(x >> 4, z >> 4, chunk.get());
+            chunks[toKey(x, z)] = std::move(chunk);
+        }
+    }
+
+    // The kind of short walk Player's collision and ray casts make
+    const int LOOKUPS = 4000000;
+    std::vector<glm::ivec3> points(LOOKUPS);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> coord(-8 * GRID, 8 * GRID - 1), height(0, 255), step(-1, 1);
+    glm::ivec3 p(0, 128, 0);
+    for (glm::ivec3 &point : points) {
+        p += glm::ivec3(step(rng), step(rng), step(rng));
+        if (rng() % 64 == 0) {
+            p = glm::ivec3(coord(rng), height(rng), coord(rng));
+        }
+        p = glm::clamp(p, glm::ivec3(-8 * GRID, 0, -8 * GRID), glm::ivec3(8 * GRID - 1, 255, 8 * GRID - 1));
+        point = p;
+    }
+
+    long long sumMap = 0, sumGrid = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const glm::ivec3 &point : points) {
+        sumMap += getBlockWithMap(chunks, point.x, point.y, point.z);
+    }
+    double mapMs = msSince(start);
+    start = std::chrono::steady_clock::now();
+    for (const glm::ivec3 &point : points) {
+        sumGrid += getBlockWithGrid(grid, point.x, point.y, point.z);
+    }
+    double gridMs = msSince(start);
+
+    std::cout << "Terrain block lookups (" << LOOKUPS / 1000000 << "M)" << std::endl;
+    std::cout << "  unordered_map: " << mapMs * 1e6 / LOOKUPS << " ns/lookup, checksum " << sumMap << std::endl;
+    std::cout << "  ChunkGrid:     " << gridMs * 1e6 / LOOKUPS << " ns/lookup, checksum " << sumGrid << std::endl;
+}
+
+static void benchmarkMeshing(std::vector<uPtr<Chunk>> &chunks, bool greedy, const char *label) {
+    ChunkSection::setGreedyMeshing(greedy);
+    MeshStats total;
+    int measured = 0;
+    for (int n = 0; n < (int)chunks.size(); n++) {
+        if (isInterior(n)) {
+            chunks[n]->markAllDirty();
+            chunks[n]->createVBOdata();
+            total.vertices += chunks[n]->meshStats().vertices;
+            total.indices += chunks[n]->meshStats().indices;
+            total.ms += chunks[n]->meshStats().ms;
+            total.allocations += chunks[n]->meshStats().allocations;
+            total.allocatedBytes += chunks[n]->meshStats().allocatedBytes;
+            measured++;
+        }
+    }
+    std::cout << "Chunk::createVBOdata, " << (greedy ? "greedy" : "per-face") << ", " << label << ": "
+              << total.ms / measured << " ms/chunk, "
+              << total.vertices / measured << " vertices, "
+              << total.indices / measured << " indices, "
+              << float(total.allocations) / measured << " allocations ("
+              << total.allocatedBytes / measured << " bytes)" << std::endl;
+}
+
+// Side length, in Chunks, of the square the throughput benchmark generates
+static const int THROUGHPUT_GRID = 16;
+
+static std::vector<uPtr<Chunk>> makeLinkedChunks() {
+    std::vector<uPtr<Chunk>> chunks;
+    for (int i = 0; i < THROUGHPUT_GRID; i++) {
+        for (int j = 0; j < THROUGHPUT_GRID; j++) {
+            chunks.push_back(mkU<Chunk>(nullptr, 16 * i, 16 * j));
+        }
+    }
+    for (int i = 0; i < THROUGHPUT_GRID; i++) {
+        for (int j = 0; j < THROUGHPUT_GRID; j++) {
+            if (i + 1 < THROUGHPUT_GRID) {
+                chunks[i * THROUGHPUT_GRID + j]->linkNeighbor(chunks[(i + 1) * THROUGHPUT_GRID + j], XPOS);
+            }
+            if (j + 1 < THROUGHPUT_GRID) {
+                chunks[i * THROUGHPUT_GRID + j]->linkNeighbor(chunks[i * THROUGHPUT_GRID + j + 1], ZPOS);
+            }
+        }
+    }
+    return chunks;
+}
+
+static void decorate(Terrain &terrain, Chunk *chunk) {
+    terrain.decorateChunk(chunk);
+    chunk->compactBlocks();
+}
+
+static void mesh(Chunk *chunk) {
+    chunk->applyPendingWrites();
+    chunk->createVBOdata();
+}
+
+// Generates, decorates and then meshes a square of Chunks the way
+// updateTerrian() used to, with a new std::thread per Chunk for each step,
+// and then on a WorkerPool
+static void benchmarkChunkThroughput(Terrain &terrain) {
+    int count = THROUGHPUT_GRID * THROUGHPUT_GRID;
+
+    std::vector<uPtr<Chunk>> chunks = makeLinkedChunks();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uPtr<Chunk> &chunk : chunks) {
+        threads.push_back(std::thread(&Terrain::fillChunk, &terrain, chunk.get()));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    for (uPtr<Chunk> &chunk : chunks) {
+        threads.push_back(std::thread(decorate, std::ref(terrain), chunk.get()));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    handOnSpills(chunks, THROUGHPUT_GRID);
+    for (uPtr<Chunk> &chunk : chunks) {
+        threads.push_back(std::thread(mesh, chunk.get()));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    double threadMs = msSince(start);
+
+    chunks = makeLinkedChunks();
+    WorkerPool pool;
+    start = std::chrono::steady_clock::now();
+    for (uPtr<Chunk> &chunk : chunks) {
+        Chunk *c = chunk.get();
+        pool.submit([&terrain, c] { terrain.fillChunk(c); });
+    }
+    pool.waitIdle();
+    for (uPtr<Chunk> &chunk : chunks) {
+        Chunk *c = chunk.get();
+        pool.submit([&terrain, c] { decorate(terrain, c); });
+    }
+    pool.waitIdle();
+    handOnSpills(chunks, THROUGHPUT_GRID);
+    for (uPtr<Chunk> &chunk : chunks) {
+        Chunk *c = chunk.get();
+        pool.submit([c] { mesh(c); });
+    }
+    pool.waitIdle();
+    double poolMs = msSince(start);
+
+    std::cout << "Chunk generation + decoration + meshing (" << count << " chunks)" << std::endl;
+    std::cout << "  thread per chunk:             " << count / (threadMs / 1000) << " chunks/s" << std::endl;
+    std::cout << "  WorkerPool (" << pool.threadCount() << " threads): "
+              << count / (poolMs / 1000) << " chunks/s" << std::endl;
+}
+
+// Saves the grid to a scratch directory of region files and loads it back,
+// against generating the same Chunks from noise
+static void benchmarkChunkStorage(Terrain &terrain, std::vector<uPtr<Chunk>> &chunks) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "minimc_benchmark_world";
+    std::filesystem::remove_all(directory);
+
+    size_t blockBytes = 0;
+    long long savedBytes = 0;
+    double loadMs = 0;
+    double generateMs = 0;
+    bool matches = true;
+    {
+        WorldStorage storage(directory.string());
+        auto start = std::chrono::steady_clock::now();
+        for (uPtr<Chunk> &chunk : chunks) {
+            blockBytes += chunk->blockMemoryUsage();
+            storage.save(chunk.get());
+        }
+        storage.flush();
+        double saveMs = msSince(start);
+        savedBytes = storage.stats().bytesWritten;
+
+        for (uPtr<Chunk> &chunk : chunks) {
+            Chunk loaded(nullptr, chunk->m_pos.x, chunk->m_pos.y);
+            start = std::chrono::steady_clock::now();
+            storage.load(&loaded);
+            loadMs += msSince(start);
+
+            Chunk generated(nullptr, chunk->m_pos.x, chunk->m_pos.y);
+            start = std::chrono::steady_clock::now();
+            terrain.fillChunk(&generated);
+            decorate(terrain, &generated);
+            generateMs += msSince(start);
+
+            for (int i = 0; i < 16 * 256 * 16 && matches; i++) {
+                matches = loaded.getBlockAt(i & 15, i >> 8, (i >> 4) & 15) == chunk->getBlockAt(i & 15, i >> 8, (i >> 4) & 15);
+            }
+        }
+        std::cout << "Chunk storage (" << chunks.size() << " chunks)" << std::endl;
+        std::cout << "  save: " << saveMs / chunks.size() << " ms / chunk, "
+                  << savedBytes / static_cast<long long>(chunks.size()) << " bytes / chunk on disk ("
+                  << blockBytes / chunks.size() << " in memory)" << std::endl;
+
+        // The files were just written, so both read paths hit a warm page cache
+        const int passes = 20;
+        for (bool mapped : {false, true}) {
+            storage.setMappedReads(mapped);
+            Chunk loaded(nullptr, 0, 0);
+            start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < passes; pass++) {
+                for (uPtr<Chunk> &chunk : chunks) {
+                    loaded.m_pos = chunk->m_pos;
+                    storage.load(&loaded);
+                }
+            }
+            double ms = msSince(start);
+            std::cout << (mapped ? "  mmap reads:     " : "  buffered reads: ")
+                      << passes * chunks.size() / (ms / 1000) << " chunks/s" << std::endl;
+        }
+    }
+    std::cout << "  load:     " << loadMs / chunks.size() << " ms / chunk"
+              << (matches ? "" : " MISMATCH") << std::endl;
+    std::cout << "  generate: " << generateMs / chunks.size() << " ms / chunk" << std::endl;
+    std::filesystem::remove_all(directory);
+}
+
+// Generates the grid with each column's climate evaluated exactly and then
+// interpolated from a fresh ZoneClimateCache, and compares the two
+static void benchmarkClimateCache() {
+    double ms[2];
+    for (bool caching : {false, true}) {
+        Terrain terrain(nullptr);
+        terrain.setClimateCaching(caching);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<uPtr<Chunk>> chunks = generateGrid(terrain);
+        ms[caching] = msSince(start) / chunks.size();
+    }
+
+    int maxHeightError = 0;
+    double heightError = 0;
+    int biomeMismatches = 0;
+    ZoneClimateCache cache;
+    int columns = GRID * 16 * GRID * 16;
+    for (int x = 0; x < GRID * 16; x++) {
+        for (int z = 0; z < GRID * 16; z++) {
+            ClimateColumn exact(ClimateSample::at(x, z));
+            ClimateColumn cached(cache.get(x, z)->sample(x, z));
+            maxHeightError = std::max(maxHeightError, std::abs(exact.height - cached.height));
+            heightError += std::abs(exact.height - cached.height);
+            biomeMismatches += exact.biome != cached.biome;
+        }
+    }
+
+    std::cout << "Column climate (" << GRID * GRID << " chunks)" << std::endl;
+    std::cout << "  exact:        " << ms[0] << " ms / chunk" << std::endl;
+    std::cout << "  " << ZoneClimate::SPACING << "-block lattice: " << ms[1] << " ms / chunk" << std::endl;
+    std::cout << "  height error: max " << maxHeightError << ", mean " << heightError / columns
+              << " blocks; "
+              << biomeMismatches << " of " << columns << " columns change biome" << std::endl;
+}
+
+// Fills the grid with the 2D caves and then the 3D ones, and compares the
+// 3D caves' interpolated density with caveDensity() at every block
+static void benchmarkCaves() {
+    double ms[2];
+    for (bool density : {false, true}) {
+        Terrain terrain(nullptr);
+        terrain.setDensityCaves(density);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < GRID * GRID; i++) {
+            Chunk chunk(nullptr, 16 * (i % GRID), 16 * (i / GRID));
+            terrain.fillChunk(&chunk);
+        }
+        ms[density] = msSince(start) / (GRID * GRID);
+    }
+
+    double latticeMs = 0, exactMs = 0;
+    int differing = 0, open = 0;
+    std::array<float, CaveDensity::HEIGHT> column;
+    std::vector<float> exact(16 * 16 * CaveDensity::HEIGHT);
+    for (int i = 0; i < GRID * GRID; i++) {
+        glm::ivec2 origin(16 * (i % GRID), 16 * (i / GRID));
+        auto start = std::chrono::steady_clock::now();
+        for (int b = 0; b < 16 * 16 * CaveDensity::HEIGHT; b++) {
+            exact[b] = caveDensity(glm::vec3(origin.x + b % 16, CaveDensity::BOTTOM + b / 256, origin.y + (b / 16) % 16));
+        }
+        exactMs += msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        CaveDensity caves(origin);
+        latticeMs += msSince(start);
+        for (int x = 0; x < 16; x++) {
+            for (int z = 0; z < 16; z++) {
+                start = std::chrono::steady_clock::now();
+                caves.column(x, z, column.data());
+                latticeMs += msSince(start);
+                for (int y = 0; y < CaveDensity::HEIGHT; y++) {
+                    differing += (column[y] > 0.f) != (exact[x + 16 * z + 256 * y] > 0.f);
+                    open += column[y] <= 0.f;
+                }
+            }
+        }
+    }
+
+    int blocks = GRID * GRID * 16 * 16 * CaveDensity::HEIGHT;
+    std::cout << "Caves (" << GRID * GRID << " chunks)" << std::endl;
+    std::cout << "  fillChunk, 2D height fields: " << ms[0] << " ms / chunk" << std::endl;
+    std::cout << "  fillChunk, 3D density:       " << ms[1] << " ms / chunk" << std::endl;
+    std::cout << "  density, " << CaveDensity::CELL_X << "x" << CaveDensity::CELL_Y << "x" << CaveDensity::CELL_Z
+              << " lattice: " << latticeMs / (GRID * GRID) << " ms / chunk, every block: "
+              << exactMs / (GRID * GRID) << " ms / chunk" << std::endl;
+    std::cout << "  " << 100.0 * open / blocks << "% of the band open; the lattice changes "
+              << differing << " of " << blocks << " blocks" << std::endl;
+}
+
+// Evaluates each noise function at the columns of a square of Chunks, one
+// column at a time and then batched, and fills the same Chunks both ways
+static void benchmarkNoise() {
+    const int side = 256;
+    const int count = side * side;
+    // Far enough from the origin that the inputs have a realistic magnitude
+    const float origin = 5000;
+    std::vector<float> x(count), z(count);
+    for (int i = 0; i < count; i++) {
+        x[i] = origin + i % side;
+        z[i] = origin + i / side;
+    }
+
+    struct NoiseFunction
+    {
+        const char *name;
+        float (*scalar)(glm::vec2);
+        void (*batched)(const float*, const float*, float*, int);
+        // What the terrain scales world columns by before calling it
+        float scale;
+    };
+    const NoiseFunction functions[] = {
+        {"SimplexNoise", SimplexNoise, SimplexNoiseBatch, 1 / 50.f},
+        {"PerlinNoise ", PerlinNoise, PerlinNoiseBatch, 1 / 50.f},
+        {"bilerpNoise ", bilerpNoise, bilerpNoiseBatch, 1},
+        {"fbm         ", fbm, fbmBatch, 1},
+        {"caveCeil    ", caveCeil, caveCeilBatch, 1},
+    };
+
+    std::cout << "Noise (" << count << " samples, " << NOISE_BATCH_WIDTH << " per instruction)" << std::endl;
+    std::vector<float> u(count), v(count), scalar(count), batched(count);
+    for (const NoiseFunction &function : functions) {
+        for (int i = 0; i < count; i++) {
+            u[i] = x[i] * function.scale;
+            v[i] = z[i] * function.scale;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            scalar[i] = function.scalar(glm::vec2(u[i], v[i]));
+        }
+        double scalarMs = msSince(start);
+        start = std::chrono::steady_clock::now();
+        function.batched(u.data(), v.data(), batched.data(), count);
+        double batchedMs = msSince(start);
+
+        int differing = 0;
+        for (int i = 0; i < count; i++) {
+            differing += scalar[i] != batched[i];
+        }
+        std::cout << "  " << function.name << "  scalar " << count / (scalarMs / 1000) << " samples/s, batched "
+                  << count / (batchedMs / 1000) << " samples/s"
+                  << (differing > 0 ? ", " + std::to_string(differing) + " MISMATCHED" : "") << std::endl;
+    }
+
+    Terrain terrain(nullptr);
+    double columnMs = 0, chunkMs = 0;
+    bool matches = true;
+    for (int i = 0; i < GRID * GRID; i++) {
+        Chunk byColumn(nullptr, 16 * (i % GRID), 16 * (i / GRID));
+        auto start = std::chrono::steady_clock::now();
+        for (int x = 0; x < 16; x++) {
+            for (int z = 0; z < 16; z++) {
+                terrain.fillColumn(&byColumn, x, z);
+            }
+        }
+        columnMs += msSince(start);
+
+        Chunk byChunk(nullptr, byColumn.m_pos.x, byColumn.m_pos.y);
+        start = std::chrono::steady_clock::now();
+        terrain.fillChunk(&byChunk);
+        chunkMs += msSince(start);
+
+        for (int b = 0; b < 16 * 256 * 16 && matches; b++) {
+            matches = byColumn.getBlockAt(b & 15, b >> 8, (b >> 4) & 15) == byChunk.getBlockAt(b & 15, b >> 8, (b >> 4) & 15);
+        }
+    }
+    std::cout << "  fillColumn: " << columnMs / (GRID * GRID) << " ms / chunk, fillChunk: "
+              << chunkMs / (GRID * GRID) << " ms / chunk" << (matches ? "" : " MISMATCH") << std::endl;
+}
+
+// Generates Chunks with the section layout this was built with, then copies
+// the generated Chunks' columns into fresh ones a block and a span at a time
+static void benchmarkColumnFill(Terrain &terrain, std::vector<uPtr<Chunk>> &chunks) {
+#ifdef SECTION_LAYOUT_YXZ
+    std::cout << "Column fill (y-innermost sections)" << std::endl;
+#else
+    std::cout << "Column fill (x-innermost sections)" << std::endl;
+#endif
+    double generateMs = 0;
+    for (int i = 0; i < GRID * GRID; i++) {
+        Chunk chunk(nullptr, 16 * (i % GRID), 16 * (i / GRID));
+        auto start = std::chrono::steady_clock::now();
+        terrain.fillChunk(&chunk);
+        generateMs += msSince(start);
+    }
+    std::cout << "  fillChunk: " << generateMs / (GRID * GRID) << " ms / chunk" << std::endl;
+
+    struct Span
+    {
+        unsigned int x, z, y0, y1;
+        BlockType type;
+    };
+    double blockMs = 0, spanMs = 0;
+    size_t spanCount = 0;
+    bool matches = true;
+    for (const uPtr<Chunk> &source : chunks) {
+        std::vector<Span> spans;
+        for (unsigned int x = 0; x < 16; x++) {
+            for (unsigned int z = 0; z < 16; z++) {
+                for (unsigned int y = 0; y < 256;) {
+                    BlockType type = source->getBlockAt(x, y, z);
+                    unsigned int end = y + 1;
+                    while (end < 256 && source->getBlockAt(x, end, z) == type) {
+                        end++;
+                    }
+                    if (type != EMPTY) {
+                        spans.push_back(Span{x, z, y, end, type});
+                    }
+                    y = end;
+                }
+            }
+        }
+        spanCount += spans.size();
+
+        Chunk byBlock(nullptr, source->m_pos.x, source->m_pos.y);
+        auto start = std::chrono::steady_clock::now();
+        for (const Span &span : spans) {
+            for (unsigned int y = span.y0; y < span.y1; y++) {
+                byBlock.setBlockAt(span.x, y, span.z, span.type);
+            }
+        }
+        blockMs += msSince(start);
+
+        Chunk bySpan(nullptr, source->m_pos.x, source->m_pos.y);
+        start = std::chrono::steady_clock::now();
+        for (const Span &span : spans) {
+            bySpan.fillSpan(span.x, span.z, span.y0, span.y1, span.type);
+        }
+        spanMs += msSince(start);
+
+        for (int b = 0; b < 16 * 256 * 16 && matches; b++) {
+            matches = byBlock.getBlockAt(b & 15, b >> 8, (b >> 4) & 15) == bySpan.getBlockAt(b & 15, b >> 8, (b >> 4) & 15);
+        }
+    }
+    std::cout << "  copying " << spanCount / chunks.size() << " spans / chunk: setBlockAt "
+              << blockMs / chunks.size() << " ms / chunk, fillSpan " << spanMs / chunks.size() << " ms / chunk"
+              << (matches ? "" : " MISMATCH") << std::endl;
+}
+
+int runBenchmarks() {
+    Terrain terrain(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uPtr<Chunk>> chunks = generateGrid(terrain);
+    std::cout << "Generated " << chunks.size() << " chunks in " << msSince(start) << " ms" << std::endl;
+
+    benchmarkFaceVisibility(chunks);
+    benchmarkBlockProperties(chunks);
+    benchmarkChunkLookup(chunks);
+    benchmarkChunkStorage(terrain, chunks);
+    benchmarkClimateCache();
+    benchmarkCaves();
+    benchmarkNoise();
+    benchmarkColumnFill(terrain, chunks);
+    bool greedy = ChunkSection::greedyMeshing();
+    // The first pass fills the mesh buffer pool and the second grows its
+    // buffers to the capacity estimates; after that rebuilds shouldn't allocate
+    benchmarkMeshing(chunks, false, "pass 1");
+    benchmarkMeshing(chunks, false, "pass 2");
+    benchmarkMeshing(chunks, false, "pass 3");
+    benchmarkMeshing(chunks, true, "pass 1");
+    ChunkSection::setGreedyMeshing(greedy);
+    benchmarkChunkThroughput(terrain);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Headless microbenchmarks for the terrain pipeline.
+// Run the program with MINIMC_BENCHMARK set in the environment
+// (e.g. MINIMC_BENCHMARK=1 ./miniMinecraft) and it prints the
+// results to stdout and exits instead of opening a window.
+// No OpenGL context is created, so only CPU-side work is measured.
+int runBenchmarks();
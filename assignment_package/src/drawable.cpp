@@ -17,12 +17,23 @@ Drawable::~Drawable()
 
 void Drawable::destroyVBOdata()
 {
-    mp_context->glDeleteBuffers(1, &m_bufIdx);
-    mp_context->glDeleteBuffers(1, &m_bufPos);
-    mp_context->glDeleteBuffers(1, &m_bufNor);
-    mp_context->glDeleteBuffers(1, &m_bufUV);
-    m_idxGenerated = m_posGenerated = m_norGenerated = m_uvGenerated = false;
-    m_count = -1;
+    // Only delete the buffers that were generated; the others hold no name
+    std::pair<bool*, GLuint*> buffers[] = {
+        {&m_idxGenerated, &m_bufIdx}, {&m_posGenerated, &m_bufPos},
+        {&m_norGenerated, &m_bufNor}, {&m_colGenerated, &m_bufCol},
+        {&m_uvGenerated, &m_bufUV}, {&m_interleaveGenerated, &m_bufInterleave},
+        {&m_idxGenerated_transparent, &m_bufIdx_transparent},
+        {&m_interleaveGenerated_transparent, &m_bufInterleave_transparent},
+        {&m_idxGenerated_after_transparent, &m_bufIdx_after_transparent},
+        {&m_interleaveGenerated_after_transparent, &m_bufInterleave_after_transparent}
+    };
+    for (auto &[generated, buffer] : buffers) {
+        if (*generated) {
+            mp_context->glDeleteBuffers(1, buffer);
+            *generated = false;
+        }
+    }
+    m_count = m_count_transparent = m_count_after_transparent = -1;
 }
 
 GLenum Drawable::drawMode()
@@ -36,6 +47,21 @@ GLenum Drawable::drawMode()
     return GL_TRIANGLES;
 }
 
+GLenum Drawable::idxType()
+{
+    return GL_UNSIGNED_INT;
+}
+
+int Drawable::baseVertex()
+{
+    return 0;
+}
+
+int Drawable::baseVertex_transparent()
+{
+    return 0;
+}
+
 int Drawable::elemCount()
 {
     return m_count;
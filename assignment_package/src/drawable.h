@@ -54,6 +54,13 @@ public:
 
     // Getter functions for various GL data
     virtual GLenum drawMode();
+    // The type of the indices bindIdx() binds: GL_UNSIGNED_INT unless a
+    // subclass draws from a different index buffer
+    virtual GLenum idxType();
+    // Added to every index before it is used to fetch a vertex, for
+    // subclasses whose vertices don't start at the beginning of their buffer
+    virtual int baseVertex();
+    virtual int baseVertex_transparent();
     int elemCount();
     int elemCount_transparent();
     int elemCount_after_transparent();
@@ -74,11 +81,11 @@ public:
     void generateCol();
     void generateUV();
 
-    bool bindIdx();
-    bool bindInterleave();
+    virtual bool bindIdx();
+    virtual bool bindInterleave();
 
-    bool bindIdx_transparent();
-    bool bindInterleave_transparent();
+    virtual bool bindIdx_transparent();
+    virtual bool bindInterleave_transparent();
 
     bool bindIdx_after_transparent();
     bool bindInterleave_after_transparent();
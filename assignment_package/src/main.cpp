@@ -1,4 +1,5 @@
 #include <mainwindow.h>
+#include "benchmark.h"
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -24,6 +25,11 @@ int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    // Headless terrain benchmarks; see benchmark.h
+    if (qgetenv("MINIMC_BENCHMARK") != nullptr) {
+        return runBenchmarks();
+    }
+
     // Set OpenGL 4.0 and, optionally, 4-sample multisampling
     QSurfaceFormat format;
     format.setVersion(4, 0);
@@ -2,6 +2,7 @@
 #include <glm_includes.h>
 
 #include <iostream>
+#include <random>
 #include <QApplication>
 #include <QKeyEvent>
 
@@ -103,6 +104,12 @@ void MyGL::initializeGL()
     m_textureBetter.load(2);
     m_textureBetter.bind(2);
 
+    // Chunks the player has visited are saved here and loaded back instead
+    // of generated. A new world gets a random seed; an existing one keeps
+    // the seed it was generated from.
+    m_terrain.setSeed(std::random_device()());
+    m_terrain.setWorldStorage(mkU<WorldStorage>("world"));
+
 //    m_terrain.CreateTestScene();
 }
 
@@ -150,7 +157,7 @@ void MyGL::tick() {
     m_player.tick(dT, m_inputs);
     m_currentMSecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
 
-    m_terrain.updateTerrian(m_player.mcr_position);
+    m_terrain.updateTerrian(m_player.mcr_position, m_player.mcr_camera.getForward());
 
 
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
@@ -168,6 +175,62 @@ void MyGL::sendPlayerDataToGUI() const {
     glm::ivec2 zone(64 * glm::ivec2(glm::floor(pPos / 64.f)));
     emit sig_sendPlayerChunk(QString::fromStdString("( " + std::to_string(chunk.x) + ", " + std::to_string(chunk.y) + " )"));
     emit sig_sendPlayerTerrainZone(QString::fromStdString("( " + std::to_string(zone.x) + ", " + std::to_string(zone.y) + " )"));
+
+    int chunks = m_terrain.chunkCount();
+    float blockKB = m_terrain.blockMemoryUsage() / 1024.f;
+    MeshStats mesh = m_terrain.averageMeshStats();
+    MeshArena::Stats arena = ChunkSection::meshArena().stats();
+    const DrawStats &draw = m_terrain.drawStats();
+    const ChunkLoadStats &load = m_terrain.loadStats();
+    WorldStorage::Stats storage = m_terrain.worldStorage() != nullptr ? m_terrain.worldStorage()->stats()
+                                                                      : WorldStorage::Stats();
+    emit sig_sendTerrainStats(QString::fromStdString(std::to_string(chunks) + " chunks, blocks: " +
+                                                     std::to_string(static_cast<int>(blockKB)) + " KB (" +
+                                                     std::to_string(static_cast<int>(chunks > 0 ? blockKB / chunks : 0.f)) +
+                                                     " KB / chunk)\n" +
+                                                     (ChunkSection::greedyMeshing() ? "greedy" : "per-face") + " mesh: " +
+                                                     std::to_string(mesh.vertices) + " verts, " +
+                                                     std::to_string(mesh.indices) + " indices, " +
+                                                     std::to_string(mesh.ms) + " ms / chunk, " +
+                                                     std::to_string(mesh.allocations) + " allocations (" +
+                                                     std::to_string(mesh.allocatedBytes / 1024) + " KB) / chunk\n" +
+                                                     "GPU mesh arena: " + std::to_string(arena.usedBytes / 1024) + " KB used, " +
+                                                     std::to_string(arena.freeBytes / 1024) + " KB free in " +
+                                                     std::to_string(arena.pages) + " pages, " +
+                                                     std::to_string(arena.compactions) + " compactions\n" +
+                                                     (m_terrain.batchedDrawing() ? "batched" : "per-section") + " draw: " +
+                                                     std::to_string(draw.drawCalls) + " calls for " +
+                                                     std::to_string(draw.sections) + " sections (" +
+                                                     std::to_string(draw.sectionsCulled) + " culled, " +
+                                                     std::to_string(draw.sectionsOccluded) + " occluded" +
+                                                     (m_terrain.occlusionCulling() ? "" : " [off]") + "), " +
+                                                     std::to_string(draw.chunksDrawn) + " chunks (" +
+                                                     std::to_string(draw.chunksCulled) + " culled), " +
+                                                     std::to_string(draw.cpuMs) + " ms CPU\n" +
+                                                     (m_terrain.prioritizedLoading() ? "prioritized" : "FIFO") + " loading: " +
+                                                     std::to_string(load.jobsQueued) + " jobs queued, " +
+                                                     std::to_string(load.jobsParked) + " parked (" +
+                                                     std::to_string(load.jobsCancelled) + " cancelled), " +
+                                                     std::to_string(load.chunksWaiting) + " chunks waiting on neighbors, crosshair chunk in " +
+                                                     std::to_string(static_cast<int>(load.crosshairMs)) + " ms (" +
+                                                     std::to_string(static_cast<int>(load.averageCrosshairMs)) + " ms avg)\n" +
+                                                     "uploads: " + std::to_string(load.uploadedChunks) + " chunks (" +
+                                                     std::to_string(load.uploadBytes / 1024) + " KB) in " +
+                                                     std::to_string(load.uploadMs) + " ms, worst " +
+                                                     std::to_string(load.worstUploadMs) + " ms, " +
+                                                     std::to_string(load.pendingUploads) + " waiting" +
+                                                     (m_terrain.uploadBudgetMs() > 0.f ? "" : " [no budget]") + "\n" +
+                                                     "zones: " + std::to_string(load.loadedZones) + " loaded (" +
+                                                     std::to_string(load.leftZones) + " out of range), " +
+                                                     std::to_string(load.unloadedZones) + " unloaded, " +
+                                                     std::to_string(load.residentBytes >> 20) + " / " +
+                                                     std::to_string(m_terrain.memoryBudget() >> 20) + " MB" +
+                                                     (storage.chunksLoaded + storage.chunksSaved > 0 ?
+                                                          "\nsaves: " + std::to_string(storage.chunksLoaded) + " chunks loaded (" +
+                                                          std::to_string(storage.averageLoadMs) + " ms each), " +
+                                                          std::to_string(storage.chunksSaved) + " saved (" +
+                                                          std::to_string(storage.bytesWritten / 1024) + " KB), " +
+                                                          std::to_string(storage.corruptChunks) + " corrupt" : "")));
 }
 
 void MyGL::sendInventoryDataToGUI() const {
@@ -265,7 +328,9 @@ void MyGL::renderTerrain() {
     m_texture.bind(0);
     m_textureNormal.bind(1);
     m_textureBetter.bind(2);
-    m_terrain.draw(x - 256, x + 256, z - 256, z + 256, &m_progLambert);
+    m_terrain.draw(x - 256, x + 256, z - 256, z + 256,
+                   Frustum(m_player.mcr_camera.getViewProj()),
+                   m_player.mcr_camera.mcr_position, &m_progLambert);
 
 
 }
@@ -305,11 +370,32 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
     } else if (e->key() == Qt::Key_E) {
         m_inputs.ePressed = true;
     } else if (e->key() == Qt::Key_Space) {
-        if (m_inputs.isOnGround || m_player.getCameraBlock(m_terrain) == WATER || m_player.getCameraBlock(m_terrain) == LAVA) {
+        if (m_inputs.isOnGround || blockProperties(m_player.getCameraBlock(m_terrain)).has(BLOCK_LIQUID)) {
             m_inputs.spacePressed = true;
         }
     } else if (e->key() == Qt::Key_F) {
         m_inputs.flight_mode = !m_inputs.flight_mode;
+    } else if (e->key() == Qt::Key_G) {
+        // Switch between per-face and greedy meshing and rebuild every Chunk
+        ChunkSection::setGreedyMeshing(!ChunkSection::greedyMeshing());
+        m_terrain.remeshAll();
+    } else if (e->key() == Qt::Key_B) {
+        // Switch between one draw call per arena page and one per section
+        m_terrain.setBatchedDrawing(!m_terrain.batchedDrawing());
+    } else if (e->key() == Qt::Key_O) {
+        // Switch occlusion culling through cave walls on and off
+        m_terrain.setOcclusionCulling(!m_terrain.occlusionCulling());
+    } else if (e->key() == Qt::Key_P) {
+        // Switch between loading the Chunks in view first and in order
+        m_terrain.setPrioritizedLoading(!m_terrain.prioritizedLoading());
+    } else if (e->key() == Qt::Key_L) {
+        // Switch between budgeted uploads and uploading every finished mesh
+        // as soon as it arrives
+        if (m_terrain.uploadBudgetMs() > 0.f) {
+            m_terrain.setUploadBudget(0.f, 0);
+        } else {
+            m_terrain.setUploadBudget(Terrain::DEFAULT_UPLOAD_BUDGET_MS, Terrain::DEFAULT_UPLOAD_BUDGET_BYTES);
+        }
     } else if (e->key() == Qt::Key_I) {
         openInventory = true;
         emit sig_inventoryOpenClose(openInventory);
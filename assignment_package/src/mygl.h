@@ -105,6 +105,7 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    void sig_sendTerrainStats(QString) const;
 
     void sig_inventoryOpenClose(bool);
     void sig_sendNumGrass(int) const;
@@ -8,7 +8,8 @@
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
+    : QOpenGLWidget(parent),
+      m_multiDrawElementsBaseVertex(nullptr), m_multiDrawResolved(false)
 {}
 
 OpenGLContext::~OpenGLContext()
@@ -142,3 +143,26 @@ void OpenGLContext::printShaderInfoLog(int shader)
     // Throwing here allows us to use the debugger to track down the error.
     throw;
 }
+
+int OpenGLContext::multiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                               const void *const *indices, GLsizei drawcount,
+                                               const GLint *basevertex)
+{
+    if (drawcount <= 0) {
+        return 0;
+    }
+    if (!m_multiDrawResolved) {
+        // Needs a current context, so it can't happen in the constructor
+        m_multiDrawElementsBaseVertex = reinterpret_cast<MultiDrawElementsBaseVertex>(
+                    context()->getProcAddress("glMultiDrawElementsBaseVertex"));
+        m_multiDrawResolved = true;
+    }
+    if (m_multiDrawElementsBaseVertex != nullptr) {
+        m_multiDrawElementsBaseVertex(mode, count, type, indices, drawcount, basevertex);
+        return 1;
+    }
+    for (GLsizei i = 0; i < drawcount; i++) {
+        glDrawElementsBaseVertex(mode, count[i], type, indices[i], basevertex[i]);
+    }
+    return drawcount;
+}
@@ -18,4 +18,20 @@ public:
     void printGLErrorLog();
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
+
+    // glMultiDrawElementsBaseVertex, which QOpenGLExtraFunctions doesn't
+    // wrap since OpenGL ES lacks it. Falls back to one glDrawElementsBaseVertex
+    // per draw when the driver doesn't have it either.
+    // Returns the number of GL draw calls it made.
+    int multiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                    const void *const *indices, GLsizei drawcount,
+                                    const GLint *basevertex);
+
+private:
+    typedef void (QOPENGLF_APIENTRYP MultiDrawElementsBaseVertex)(GLenum mode, const GLsizei *count, GLenum type,
+                                                                  const void *const *indices, GLsizei drawcount,
+                                                                  const GLint *basevertex);
+    MultiDrawElementsBaseVertex m_multiDrawElementsBaseVertex;
+    // Whether m_multiDrawElementsBaseVertex has been looked up yet
+    bool m_multiDrawResolved;
 };
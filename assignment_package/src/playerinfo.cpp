@@ -35,4 +35,7 @@ void PlayerInfo::slot_setChunkText(QString s) {
 void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
+void PlayerInfo::slot_setTerrainText(QString s) {
+    ui->terrainLabel->setText(s);
+}
 
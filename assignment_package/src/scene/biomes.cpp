@@ -1,5 +1,6 @@
 #include "biomes.h"
 #include <iostream>
+#include <atomic>
 
 /*
 Milestone 1
@@ -11,13 +12,69 @@ In both biomes, any EMPTY blocks that fall between a height of 128 and 138 shoul
 */
 
 
+static std::atomic<uint32_t> s_noiseSeed(0);
+
+void setNoiseSeed(uint32_t seed) {
+    s_noiseSeed = seed;
+}
+
+uint32_t noiseSeed() {
+    return s_noiseSeed.load(std::memory_order_relaxed);
+}
+
+static uint32_t rotl(uint32_t v, int bits) {
+    return (v << bits) | (v >> (32 - bits));
+}
+
+// xxHash32's final mix
+static uint32_t avalanche(uint32_t h) {
+    h ^= h >> 15;
+    h *= HASH_PRIME_2;
+    h ^= h >> 13;
+    h *= HASH_PRIME_3;
+    h ^= h >> 16;
+    return h;
+}
+
+// xxHash32 of the two words x and y
+uint32_t latticeHash(int32_t x, int32_t y, uint32_t channel) {
+    uint32_t h = noiseSeed() + channel * HASH_PRIME_1 + HASH_PRIME_5 + 8;
+    h = rotl(h + static_cast<uint32_t>(x) * HASH_PRIME_3, 17) * HASH_PRIME_4;
+    h = rotl(h + static_cast<uint32_t>(y) * HASH_PRIME_3, 17) * HASH_PRIME_4;
+    return avalanche(h);
+}
+
+// xxHash32 of the three words x, y and z
+uint32_t latticeHash(int32_t x, int32_t y, int32_t z, uint32_t channel) {
+    uint32_t h = noiseSeed() + channel * HASH_PRIME_1 + HASH_PRIME_5 + 12;
+    h = rotl(h + static_cast<uint32_t>(x) * HASH_PRIME_3, 17) * HASH_PRIME_4;
+    h = rotl(h + static_cast<uint32_t>(y) * HASH_PRIME_3, 17) * HASH_PRIME_4;
+    h = rotl(h + static_cast<uint32_t>(z) * HASH_PRIME_3, 17) * HASH_PRIME_4;
+    return avalanche(h);
+}
+
+// The lattice coordinate v, which is already an integer. Those too large
+// for an int32_t become INT32_MIN, as they do in SSE's conversions.
+static int32_t latticeCoordinate(float v) {
+    if (v >= 2147483648.f || v < -2147483648.f) {
+        return INT32_MIN;
+    }
+    return static_cast<int32_t>(v);
+}
+
+// The top 24 bits of a hash as a float in [0, 1)
+static float unitFloat(uint32_t h) {
+    return (h >> 8) * (1.f / 16777216.f);
+}
+
 float random1(glm::vec2 p) {
-    return glm::fract(sin(glm::dot(p, glm::vec2(127.1,311.7)))*43758.5453);
+    return unitFloat(latticeHash(latticeCoordinate(p.x), latticeCoordinate(p.y), 0));
 }
 
 glm::vec2 random2(glm::vec2 p) {
-    return glm::vec2(glm::fract(sin(glm::dot(p, glm::vec2(127.1, 311.7))) * 43758.5453),
-                     glm::fract(sin(glm::dot(p, glm::vec2(269.5, 183.3))) * 43758.5453));
+    int32_t x = latticeCoordinate(p.x);
+    int32_t y = latticeCoordinate(p.y);
+    return glm::vec2(unitFloat(latticeHash(x, y, 0)), unitFloat(latticeHash(x, y, 1)));
 }
 
 glm::vec2 rotate(glm::vec2 p, float deg) {
@@ -42,11 +99,17 @@ float WorleyNoise(glm::vec2 uv) {
     return minDist;
 }
 
+// 1 - 6d^5 + 15d^4 - 10d^3, without calling pow()
+static float falloff(float dist) {
+    float d3 = dist * dist * dist;
+    return 1.f - d3 * 6.f * dist * dist + d3 * 15.f * dist - d3 * 10.f;
+}
+
 float surflet(glm::vec2 P, glm::vec2 gridPoint) {
     float distX = glm::abs(P.x - gridPoint.x);
     float distY = glm::abs(P.y - gridPoint.y);
-    float tX = 1 - 6 * pow(distX, 5.0) + 15 * pow(distX, 4.0) - 10 * pow(distX, 3.0);
-    float tY = 1 - 6 * pow(distY, 5.0) + 15 * pow(distY, 4.0) - 10 * pow(distY, 3.0);
+    float tX = falloff(distX);
+    float tY = falloff(distY);
 //    glm::vec2 gradient = random2(gridPoint) * 2.f - glm::vec2(1.f, 1.f);
     glm::vec2 gradient = random2(gridPoint);
 
@@ -66,10 +129,27 @@ float PerlinNoise(glm::vec2 uv) {
 }
 
 
+const glm::vec2 NOISE_GRADIENTS[16] = {
+    glm::vec2(0.800807828f, 0.159290581f),
+    glm::vec2(0.678892096f, 0.453621196f),
+    glm::vec2(0.453621196f, 0.678892096f),
+    glm::vec2(0.159290581f, 0.800807828f),
+    glm::vec2(-0.159290581f, 0.800807828f),
+    glm::vec2(-0.453621196f, 0.678892096f),
+    glm::vec2(-0.678892096f, 0.453621196f),
+    glm::vec2(-0.800807828f, 0.159290581f),
+    glm::vec2(-0.800807828f, -0.159290581f),
+    glm::vec2(-0.678892096f, -0.453621196f),
+    glm::vec2(-0.453621196f, -0.678892096f),
+    glm::vec2(-0.159290581f, -0.800807828f),
+    glm::vec2(0.159290581f, -0.800807828f),
+    glm::vec2(0.453621196f, -0.678892096f),
+    glm::vec2(0.678892096f, -0.453621196f),
+    glm::vec2(0.800807828f, -0.159290581f),
+};
+
 glm::vec2 hash(glm::vec2 p) {
-    p = glm::vec2(glm::dot(p, glm::vec2(127.1, 311.7)), glm::dot(p, glm::vec2(269.5, 183.3)));
-    glm::vec2 fract = glm::fract(glm::vec2(53758.5453123 * glm::cos(p.x), 53758.5453123 * glm::cos(p.y)));
-    return glm::vec2(-1.0 + 2.0 * fract.x, -1.0 + 2.0 * fract.y);
+    return NOISE_GRADIENTS[latticeHash(latticeCoordinate(p.x), latticeCoordinate(p.y), 2) >> 28];
 }
 
 float step(float edge, float x) {
@@ -85,7 +165,7 @@ float SimplexNoise(glm::vec2 p) {
     float m = step(float(a.y), float(a.x));
     glm::vec2  o = glm::vec2(m, 1.0 - m);
     glm::vec2  b = a - o + K2;
-    glm::vec2  c = glm::vec2(a.x - 1.0 + 2.0 * K2, a.y - 1.0 + 2.0 * K2);
+    glm::vec2  c = a - 1.f + 2.f * K2;
     glm::vec3  h = glm::max(glm::vec3(0.5) - glm::vec3(glm::dot(a,a), glm::dot(b,b), glm::dot(c,c)), glm::vec3(0.0));
     glm::vec3  n = h*h*h*h * glm::vec3(glm::dot(a, hash(i+glm::vec2(0.0))), glm::dot(b,hash(i+o)), glm::dot(c, hash(i+glm::vec2(1.0))));
     return glm::dot(n, glm::vec3(70.0));
@@ -107,10 +187,11 @@ float fbm(glm::vec2 uv) {
     float persistence = 0.5;
     float freq = 1.0;
     float sum = 0.0;
+    float amp = 1.0;
     for(int i = 0; i < octave; i++) {
-        float amp = pow(persistence, i);
         sum += bilerpNoise(uv * freq) * amp;
         freq *= 2.0;
+        amp *= persistence;
     }
     return sum;
 }
@@ -241,6 +322,51 @@ float caveCeil(glm::vec2 uv) {
     }
 }
 
+// The twelve edges of a cube, and four of them again to make sixteen
+const glm::vec3 NOISE_GRADIENTS_3D[16] = {
+    glm::vec3(1, 1, 0), glm::vec3(-1, 1, 0), glm::vec3(1, -1, 0), glm::vec3(-1, -1, 0),
+    glm::vec3(1, 0, 1), glm::vec3(-1, 0, 1), glm::vec3(1, 0, -1), glm::vec3(-1, 0, -1),
+    glm::vec3(0, 1, 1), glm::vec3(0, -1, 1), glm::vec3(0, 1, -1), glm::vec3(0, -1, -1),
+    glm::vec3(1, 1, 0), glm::vec3(-1, 1, 0), glm::vec3(0, -1, 1), glm::vec3(0, -1, -1)
+};
+
+// 6t^5 - 15t^4 + 10t^3
+static float fade(float t) {
+    return t * t * t * (t * (t * 6.f - 15.f) + 10.f);
+}
+
+float PerlinNoise3D(glm::vec3 p) {
+    glm::vec3 cell = glm::floor(p);
+    glm::vec3 f = p - cell;
+    int32_t x = latticeCoordinate(cell.x);
+    int32_t y = latticeCoordinate(cell.y);
+    int32_t z = latticeCoordinate(cell.z);
+    // Corner (dx, dy, dz) is entry dx + 2 * dy + 4 * dz
+    float corners[8];
+    for (int i = 0; i < 8; i++) {
+        int dx = i & 1, dy = (i >> 1) & 1, dz = i >> 2;
+        glm::vec3 gradient = NOISE_GRADIENTS_3D[latticeHash(x + dx, y + dy, z + dz, 2) >> 28];
+        corners[i] = glm::dot(gradient, f - glm::vec3(dx, dy, dz));
+    }
+    float u = fade(f.x), v = fade(f.y), w = fade(f.z);
+    float x00 = glm::mix(corners[0], corners[1], u);
+    float x10 = glm::mix(corners[2], corners[3], u);
+    float x01 = glm::mix(corners[4], corners[5], u);
+    float x11 = glm::mix(corners[6], corners[7], u);
+    return glm::mix(glm::mix(x00, x10, v), glm::mix(x01, x11, v), w);
+}
+
+float caveDensity(glm::vec3 p) {
+    // Squashed vertically, so caves run sideways more than up and down
+    glm::vec3 q = p / glm::vec3(48.f, 24.f, 48.f);
+    float n = PerlinNoise3D(q) + 0.5f * PerlinNoise3D(q * 2.f + glm::vec3(31.7f, 11.3f, 57.1f));
+    // Solid towards the bedrock and the surface, so caves rarely break
+    // through either
+    float floor = glm::max(0.f, 76.f - p.y) / 24.f;
+    float roof = glm::max(0.f, p.y - 112.f) / 12.f;
+    return n + 0.05f + floor + roof;
+}
+
 float caveFloor(glm::vec2 uv) {
     float SCALE = 100.0;
     uv = uv / SCALE;
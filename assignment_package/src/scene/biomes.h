@@ -2,6 +2,7 @@
 #define BIOMES_H
 
 #include "la.h"
+#include <cstdint>
 
 enum BiomeType: unsigned char
 {
@@ -11,6 +12,29 @@ enum BiomeType: unsigned char
     ISLAND
 };
 
+// The world seed that every noise function below hashes its lattice
+// points with, so the same seed always generates the same world. Set it
+// before generating any terrain.
+void setNoiseSeed(uint32_t seed);
+uint32_t noiseSeed();
+
+// xxHash32 of lattice point (x, y) keyed by the noise seed. Each channel
+// gives an independent hash of the same point.
+uint32_t latticeHash(int32_t x, int32_t y, uint32_t channel);
+// The same for lattice point (x, y, z)
+uint32_t latticeHash(int32_t x, int32_t y, int32_t z, uint32_t channel);
+// The primes latticeHash() mixes with, from xxHash
+const uint32_t HASH_PRIME_1 = 0x9E3779B1u;
+const uint32_t HASH_PRIME_2 = 0x85EBCA77u;
+const uint32_t HASH_PRIME_3 = 0xC2B2AE3Du;
+const uint32_t HASH_PRIME_4 = 0x27D4EB2Fu;
+const uint32_t HASH_PRIME_5 = 0x165667B1u;
+// The gradients hash() picks from, evenly spread around the circle with the
+// mean squared length of the old gradients that filled [-1, 1]^2
+extern const glm::vec2 NOISE_GRADIENTS[16];
+
+// Random numbers in [0, 1) for lattice point p, which must have integer
+// coordinates. random2(p).x is random1(p).
 float random1(glm::vec2 p);
 
 glm::vec2 random2(glm::vec2 p);
@@ -25,6 +49,7 @@ float surflet(glm::vec2 P, glm::vec2 gridPoint);
 float PerlinNoise(glm::vec2 uv);
 
 
+// The gradient at lattice point p, one of NOISE_GRADIENTS
 glm::vec2 hash(glm::vec2 p);
 
 float SimplexNoise(glm::vec2 p);
@@ -49,4 +74,14 @@ float caveCeil(glm::vec2 uv);
 
 float caveFloor(glm::vec2 uv);
 
+// The gradients PerlinNoise3D() picks from
+extern const glm::vec3 NOISE_GRADIENTS_3D[16];
+
+// Gradient noise in about [-1, 1], with quintic fades between the corners
+float PerlinNoise3D(glm::vec3 p);
+
+// The density of the cave band, Y = 64 to 128, at world block p: solid
+// where positive, open where not
+float caveDensity(glm::vec3 p);
+
 #endif
@@ -0,0 +1,52 @@
+#include "cavedensity.h"
+#include "biomes.h"
+#include "noisebatch.h"
+
+CaveDensity::CaveDensity(glm::ivec2 origin)
+    : m_origin(origin), m_lattice()
+{
+    for (int i = 0; i < POINTS_X; i++) {
+        for (int k = 0; k < POINTS_Z; k++) {
+            sampleColumn(origin.x + CELL_X * i, origin.y + CELL_Z * k, &m_lattice[POINTS_Y * (i + POINTS_X * k)]);
+        }
+    }
+}
+
+void CaveDensity::sampleColumn(int x, int z, float *out) {
+    for (int j = 0; j < POINTS_Y; j++) {
+        out[j] = caveDensity(glm::vec3(x, BOTTOM + CELL_Y * j, z));
+    }
+}
+
+void CaveDensity::interpolate(const float *c00, const float *c10, const float *c01, const float *c11,
+                              float fx, float fz, float *out) {
+    // Bilinear across the cell at each lattice height, then linear up the
+    // column between them, a whole cell at a time
+    float ends[POINTS_Y];
+    for (int j = 0; j < POINTS_Y; j++) {
+        float lower = c00[j] + (c10[j] - c00[j]) * fx;
+        float upper = c01[j] + (c11[j] - c01[j]) * fx;
+        ends[j] = lower + (upper - lower) * fz;
+    }
+    rampBatch(ends, POINTS_Y - 1, CELL_Y, out);
+}
+
+void CaveDensity::column(int x, int z, float *out) const {
+    int i = x / CELL_X;
+    int k = z / CELL_Z;
+    float fx = (x % CELL_X) / static_cast<float>(CELL_X);
+    float fz = (z % CELL_Z) / static_cast<float>(CELL_Z);
+    const float *c00 = &m_lattice[POINTS_Y * (i + POINTS_X * k)];
+    interpolate(c00, c00 + POINTS_Y, c00 + POINTS_Y * POINTS_X, c00 + POINTS_Y * (POINTS_X + 1), fx, fz, out);
+}
+
+void CaveDensity::columnAt(int x, int z, float *out) {
+    int x0 = CELL_X * static_cast<int>(glm::floor(x / static_cast<float>(CELL_X)));
+    int z0 = CELL_Z * static_cast<int>(glm::floor(z / static_cast<float>(CELL_Z)));
+    float c00[POINTS_Y], c10[POINTS_Y], c01[POINTS_Y], c11[POINTS_Y];
+    sampleColumn(x0, z0, c00);
+    sampleColumn(x0 + CELL_X, z0, c10);
+    sampleColumn(x0, z0 + CELL_Z, c01);
+    sampleColumn(x0 + CELL_X, z0 + CELL_Z, c11);
+    interpolate(c00, c10, c01, c11, (x - x0) / static_cast<float>(CELL_X), (z - z0) / static_cast<float>(CELL_Z), out);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+
+// One Chunk's cave band, Y = BOTTOM up to TOP, as caveDensity() evaluated
+// every CELL_X x CELL_Y x CELL_Z blocks and trilinearly interpolated in
+// between, so the 3D noise is evaluated 225 times per Chunk instead of
+// 16384. Lattice points sit on the Chunk's edges, so neighboring Chunks
+// agree where they meet.
+class CaveDensity
+{
+public:
+    static const int BOTTOM = 64;
+    static const int TOP = 128;
+    static const int HEIGHT = TOP - BOTTOM;
+    static const int CELL_X = 4;
+    static const int CELL_Y = 8;
+    static const int CELL_Z = 4;
+    static const int POINTS_X = 16 / CELL_X + 1;
+    static const int POINTS_Y = HEIGHT / CELL_Y + 1;
+    static const int POINTS_Z = 16 / CELL_Z + 1;
+
+private:
+    // Lower-left corner of the Chunk in world space
+    glm::ivec2 m_origin;
+    // Lattice column (i, k) is the POINTS_Y entries from
+    // POINTS_Y * (i + POINTS_X * k), bottom first
+    std::array<float, POINTS_X * POINTS_Y * POINTS_Z> m_lattice;
+
+    // caveDensity() down the lattice column at world (x, z)
+    static void sampleColumn(int x, int z, float *out);
+    // Column (fx, fz) of the way across the cell between four lattice
+    // columns, bottom first, HEIGHT values
+    static void interpolate(const float *c00, const float *c10, const float *c01, const float *c11,
+                            float fx, float fz, float *out);
+
+public:
+    explicit CaveDensity(glm::ivec2 origin);
+
+    // The density of each block of column (x, z) of the Chunk, bottom first
+    void column(int x, int z, float *out) const;
+    // The same for world column (x, z) without building the whole Chunk's
+    // lattice, sampling just the four lattice columns around it
+    static void columnAt(int x, int z, float *out);
+};
@@ -1,358 +1,240 @@
  #include "chunk.h"
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <chrono>
+#include <algorithm>
 
 
 Chunk::Chunk(OpenGLContext* context, int x, int z)
-     : Drawable(context),
-       m_blocks(),
+     : m_sections(), // Every section starts out as uniform EMPTY
+       m_sectionMeshes(),
+       m_blocksMutex(),
+       m_unsaved(false),
+       m_pendingWrites(nullptr),
        m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
+       m_spilled(),
        m_pos(glm::ivec2(x,z))
 
 {
-   std::fill_n(m_blocks.begin(), 65536, EMPTY);
+    for (int i = 0; i < 16; i++) {
+        m_sectionMeshes[i] = mkU<ChunkSection>(context, this, i);
+    }
 }
 
-Chunk::~Chunk(){}
+Chunk::~Chunk(){
+   PendingWriteBatch *batch = m_pendingWrites.exchange(nullptr);
+   while (batch != nullptr) {
+       PendingWriteBatch *next = batch->next;
+       delete batch;
+       batch = next;
+   }
+}
 
 void Chunk::createVBOdata() {
-   std::vector<glm::vec4> VBOdata;
-   std::vector<GLuint> idx;
-
-   std::vector<glm::vec4> VBOdata_transparent;
-   std::vector<GLuint> idx_transparent;
-
-   std::vector<glm::vec4> VBOdata_after_transparent;
-   std::vector<GLuint> idx_after_transparent;
-
-//    std::unordered_map<BlockType, glm::vec4> blockColorMp = {
-
-//        {GRASS, glm::vec4(95.f, 159.f, 53.f, 0) / 255.f},
-//        {DIRT, glm::vec4(121.f, 85.f, 58.f, 0) / 255.f},
-//        {STONE, glm::vec4(0.5, 0.5, 0.5f, 0)},
-//        {WATER, glm::vec4(0.f, 0.f, 0.75f, 0)},
-//        {SNOW, glm::vec4(1.f, 1.f, 1.f, 0)},
-//        {SAND, glm::vec4(1.f, 0.95, 0.9f, 0)}
-
-//    };
-
-   //front 1, back 2, left 3, right 4, up 5, down 6
-//    std::vector<std::pair<int, int>> blockFaceNeedRender;
-
-    int currentIdx = 0;
-    int currentIdx_transparent = 0;
-    int currentIdx_after_transparent = 0;
-    for (int z = 0; z < 16; z++){
-        for (int y = 0; y < 256; y++){
-            for (int x = 0; x < 16; x++){
-
-                BlockType current = getBlockAt(x, y, z);
-                glm::vec4 currentPos = glm::vec4(x, y, z, 0);
-                if (current != EMPTY){
-
-                    for (BlockFace neighborFace : adjacentFaces){
-                        if (current == BAMBOO &&
-                                (neighborFace.direction == YPOS || neighborFace.direction == YNEG)){
-                            continue;
-                        }
-                        if (current == PAD){
-                            if (neighborFace.direction != YPOS){
-                                continue;
-                            }
-                        }
-                        if (noNormal.find(current) != noNormal.end()) {
-                            if (neighborFace.directionVec == glm::vec3(1, 0, 0)){
-                                continue;
-                            }
-                            if (neighborFace.directionVec == glm::vec3(-1, 0, 0)){
-                                continue;
-                            }
-                            if (neighborFace.directionVec == glm::vec3(0, -1, 0)){
-                                continue;
-                            }
-                            if (neighborFace.directionVec == glm::vec3(0, 0, 1)){
-                                continue;
-                            }
-                            if (neighborFace.directionVec == glm::vec3(0, 0, -1)){
-                                continue;
-                            }
-                        }
-                        glm::vec3 neighborPos = neighborFace.directionVec
-                                + glm::vec3(x, y, z);
-//                        std::cout<<getBlockAt(0, 0, 0)<<std::endl;
-                        BlockType neighborType;
-                        if ((x == 0 || z == 0 || x == 15 || z == 15) and neighborFace.direction != YPOS and neighborFace.direction != YNEG){
-                            Chunk* neighborChunk = m_neighbors[neighborFace.direction];
-                            if (neighborChunk == nullptr){
-                                neighborType = EMPTY;
-//                                continue;
-                            }
-                            else{
-                                if (neighborFace.direction == XNEG && x == 0){
-                                    neighborType = neighborChunk->getBlockAt(int(15),
-                                                                             int(neighborPos.y),
-                                                                             int(neighborPos.z));
-                                } else if (neighborFace.direction == XPOS && x == 15){
-                                    neighborType = neighborChunk->getBlockAt(int(0),
-                                                                             int(neighborPos.y),
-                                                                             int(neighborPos.z));
-
-                                } else if (neighborFace.direction == ZPOS && z == 15){
-                                    neighborType = neighborChunk->getBlockAt(int(neighborPos.x),
-                                                                             int(neighborPos.y),
-                                                                             int(0));
-                                } else if (neighborFace.direction == ZNEG && z == 0){
-                                    neighborType = neighborChunk->getBlockAt(int(neighborPos.x),
-                                                                             int(neighborPos.y),
-                                                                             int(15));
-                                }
-                                else{
-                                    neighborType = getBlockAt(int(neighborPos.x),
-                                                                    int(neighborPos.y),
-                                                                    int(neighborPos.z));
-                                }
-                            }
-
-
-                        }else{
-                            neighborType = getBlockAt(int(neighborPos.x),
-                                                            int(neighborPos.y),
-                                                            int(neighborPos.z));
-                        }
-
-                        if (transparentBlock.find(current) == transparentBlock.end()) {
-                            if (neighborType == EMPTY || transparentBlock.find(neighborType) != transparentBlock.end()){
-                                for (int i = 0; i < 4; i++){
-
-                                    VBOdata.push_back(neighborFace.vertices[i].m_pos + currentPos);
-                                    if (usingBetterTexture.find(current) == usingBetterTexture.end()){
-                                        VBOdata.push_back(glm::vec4(neighborFace.vertices[i].m_uv +
-                                                                blockFaceUV[current][neighborFace.direction], 0, 0));
-                                    }else{
-                                        VBOdata.push_back(glm::vec4(neighborFace.vertices[i].m_uv +
-                                                                blockFaceUV[current][neighborFace.direction], 0.2, 0));
-                                    }
-
-                                    VBOdata.push_back(glm::vec4(neighborFace.directionVec, 0.5));
-
-                                }
-                                idx.push_back(currentIdx);
-                                idx.push_back(currentIdx + 1);
-                                idx.push_back(currentIdx + 2);
-                                idx.push_back(currentIdx);
-                                idx.push_back(currentIdx + 2);
-                                idx.push_back(currentIdx + 3);
-                                currentIdx += 4;
-
-                            }
-                       }
-                       else  { // Current block is transparent, don't put walls b/t water but do b/t different transp block types
-                            if (current != WATER || (neighborType == EMPTY || neighborType == PAD)){
-                                glm::vec4 offset;
-                                if(neighborType == PAD) {
-                                    int x = 10;
-                                }
-                                if (diagnalBlock.find(current) == diagnalBlock.end()){
-
-                                    if (current == CACTUS || current == BAMBOO){
-                                        offset = glm::vec4(-neighborFace.directionVec, 0) * 0.2f;
-                                    }else if (current == CAKE && neighborFace.direction == YPOS){
-                                        offset = glm::vec4(0, -1, 0, 0) * 0.5f;
-                                    }else if (current == CAKE && neighborFace.direction == XPOS){
-                                        offset = glm::vec4(-0.1, -0.5f, 0, 0);
-                                    }else if (current == CAKE && neighborFace.direction == XNEG){
-                                        offset = glm::vec4(0.1, -0.5f, 0, 0);
-                                    }else if (current == CAKE && neighborFace.direction == ZPOS){
-                                        offset = glm::vec4(0, -0.5f, -0.1, 0);
-                                    }else if (current == CAKE && neighborFace.direction == ZNEG){
-                                        offset = glm::vec4(0, -0.5f, 0.1, 0);
-                                    }else if (current == PAD){
-                                        offset = glm::vec4(0, -1.f, 0, 0);
-                                    }
-                                    else{
-                                        offset = glm::vec4(0);
-                                    }
-                                    if (false/*current == PAD*/){
-                                        for (int i = 0; i < 4; i++){
-
-                                            VBOdata_after_transparent.push_back(neighborFace.vertices[i].m_pos + currentPos+ offset);
-                                            if (usingBetterTexture.find(current) == usingBetterTexture.end()){
-                                                VBOdata_after_transparent.push_back(glm::vec4(neighborFace.vertices[i].m_uv +
-                                                                        blockFaceUV[current][neighborFace.direction], 0, 0));
-                                            }else{
-
-                                                VBOdata_after_transparent.push_back(glm::vec4(neighborFace.vertices[i].m_uv +
-                                                                        blockFaceUV[current][neighborFace.direction], 0.2, 0));
-                                            }
-                                            if (noNormal.find(current) != noNormal.end()){
-                                                VBOdata_after_transparent.push_back(glm::vec4(neighborFace.directionVec, 0));
-                                            }else{
-                                                VBOdata_after_transparent.push_back(glm::vec4(neighborFace.directionVec, 0.5));
-                                            }
-
-                                        }
-                                        idx_after_transparent.push_back(currentIdx_after_transparent);
-                                        idx_after_transparent.push_back(currentIdx_after_transparent + 1);
-                                        idx_after_transparent.push_back(currentIdx_after_transparent + 2);
-                                        idx_after_transparent.push_back(currentIdx_after_transparent);
-                                        idx_after_transparent.push_back(currentIdx_after_transparent + 2);
-                                        idx_after_transparent.push_back(currentIdx_after_transparent + 3);
-                                        currentIdx_after_transparent += 4;
-
-                                    }else{
-                                        for (int i = 0; i < 4; i++){
-
-                                            VBOdata_transparent.push_back(neighborFace.vertices[i].m_pos + currentPos+ offset);
-                                            if (usingBetterTexture.find(current) == usingBetterTexture.end()){
-                                                VBOdata_transparent.push_back(glm::vec4(neighborFace.vertices[i].m_uv +
-                                                                        blockFaceUV[current][neighborFace.direction], 0, 0));
-                                            }else{
-
-                                                VBOdata_transparent.push_back(glm::vec4(neighborFace.vertices[i].m_uv +
-                                                                        blockFaceUV[current][neighborFace.direction], 0.2, 0));
-                                            }
-                                            if (noNormal.find(current) != noNormal.end()){
-                                                VBOdata_transparent.push_back(glm::vec4(neighborFace.directionVec, 0));
-                                            }else{
-                                                VBOdata_transparent.push_back(glm::vec4(neighborFace.directionVec, 0.5));
-                                            }
-
-                                        }
-                                    }
-                                }else{
-                                    int diagIdx;
-                                    if (neighborFace.direction == XPOS){
-                                        diagIdx = 0;
-                                    }else if (neighborFace.direction == XNEG){
-                                        diagIdx = 1;
-                                    }else{
-                                        continue;
-                                    }
-                                    for (int i = 0; i < 4; i++){
-                                        VBOdata_transparent.push_back(diagnalFaces[diagIdx].vertices[i].m_pos + currentPos);
-                                        if (usingBetterTexture.find(current) == usingBetterTexture.end()){
-                                            VBOdata_transparent.push_back(glm::vec4(diagnalFaces[diagIdx].vertices[i].m_uv +
-                                                                    blockFaceUV[current][diagnalFaces[diagIdx].direction], 0, 0));
-                                        }else{
-
-                                            VBOdata_transparent.push_back(glm::vec4(diagnalFaces[diagIdx].vertices[i].m_uv +
-                                                                    blockFaceUV[current][diagnalFaces[diagIdx].direction], 0.2, 0));
-                                        }
-                                        if (noNormal.find(current) != noNormal.end()){
-                                            VBOdata_transparent.push_back(glm::vec4(diagnalFaces[diagIdx].directionVec, 0));
-                                        }else{
-                                            VBOdata_transparent.push_back(glm::vec4(diagnalFaces[diagIdx].directionVec, 0.5));
-                                        }
-                                    }
-                                }
-                                if (true/*current != PAD*/){
-                                    idx_transparent.push_back(currentIdx_transparent);
-                                    idx_transparent.push_back(currentIdx_transparent + 1);
-                                    idx_transparent.push_back(currentIdx_transparent + 2);
-                                    idx_transparent.push_back(currentIdx_transparent);
-                                    idx_transparent.push_back(currentIdx_transparent + 2);
-                                    idx_transparent.push_back(currentIdx_transparent + 3);
-                                    currentIdx_transparent += 4;
-                                }
-
-                            }
-                       }
-
-                    }
-
-                }
-            }
-        }
-    }
+   // Neighbors may still be placing their pending writes while we read their edges
+   std::array<std::shared_lock<std::shared_mutex>, 4> neighborLocks;
+   int lockCount = 0;
+   for (auto &[dir, neighbor] : m_neighbors) {
+       if (neighbor != nullptr) {
+           neighborLocks[lockCount++] = std::shared_lock<std::shared_mutex>(neighbor->blocksMutex());
+       }
+   }
 
+   auto start = std::chrono::steady_clock::now();
+   MeshAllocationCounter allocationsBefore = meshAllocationCounter();
+   MeshStats stats;
+   for (uPtr<ChunkSection> &section : m_sectionMeshes) {
+       // Clear the flag before meshing so an edit that lands
+       // mid-rebuild leaves the section dirty for next time
+       if (section->takeDirty()) {
+           section->createVBOdata();
+       }
+       stats.vertices += section->vertexCount();
+       stats.indices += section->indexCount();
+   }
+   stats.ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+   stats.allocations = meshAllocationCounter().allocations - allocationsBefore.allocations;
+   stats.allocatedBytes = meshAllocationCounter().bytes - allocationsBefore.bytes;
+   m_meshStats = stats;
+}
 
+void Chunk::sendVBOdata() {
+   for (uPtr<ChunkSection> &section : m_sectionMeshes) {
+       section->sendVBOdata();
+   }
+}
 
+static void checkBounds(unsigned int x, unsigned int y, unsigned int z) {
+   if (x >= 16 || y >= 256 || z >= 16) {
+       throw std::out_of_range("Local coordinates " + std::to_string(x) + " " +
+                               std::to_string(y) + " " + std::to_string(z) +
+                               " lie outside the Chunk!");
+   }
+}
 
+// Does bounds checking like std::array::at()
+BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
+   checkBounds(x, y, z);
+   return m_sections[y >> 4].get(PalettedSection::index(x, y & 15, z));
+}
 
-   this->m_count = idx.size();
-   this->m_count_transparent = idx_transparent.size();
+// Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
+BlockType Chunk::getBlockAt(int x, int y, int z) const {
+   if (y < 0 || y > 255){
+       return EMPTY;
+   }
+   return getBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
+}
+
+// Does bounds checking like std::array::at()
+void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
+   checkBounds(x, y, z);
+   PalettedSection &section = m_sections[y >> 4];
+   unsigned int i = PalettedSection::index(x, y & 15, z);
+   if (section.get(i) == t) {
+       return;
+   }
+   section.set(i, t);
+   m_unsaved = true;
+   markDirty(y);
+   if ((y & 15) == 0 && y > 0) {
+       markDirty(y - 1);
+   } else if ((y & 15) == 15 && y < 255) {
+       markDirty(y + 1);
+   }
+}
+
+void Chunk::fillSpan(unsigned int x, unsigned int z, unsigned int y0, unsigned int y1, BlockType t) {
+   if (y0 >= y1) {
+       return;
+   }
+   checkBounds(x, y0, z);
+   checkBounds(x, y1 - 1, z);
+   for (unsigned int y = y0; y < y1; y = (y | 15) + 1) {
+       unsigned int end = std::min(y1, (y | 15) + 1);
+       m_sections[y >> 4].fillSpan(x, z, y & 15, end - (y & ~15u), t);
+       markDirty(y);
+   }
+   // As in setBlockAt(), the sections bordering the span see it too
+   if ((y0 & 15) == 0 && y0 > 0) {
+       markDirty(y0 - 1);
+   }
+   if ((y1 & 15) == 0 && y1 < 256) {
+       markDirty(y1);
+   }
+   m_unsaved = true;
+}
 
-   this->m_VBOdata.idx = idx;
-   this->m_VBOdata.data = VBOdata;
+const PalettedSection& Chunk::blockSection(int i) const {
+   return m_sections.at(i);
+}
 
-   this->m_VBOdata_transparent.idx = idx_transparent;
-   this->m_VBOdata_transparent.data = VBOdata_transparent;
+ChunkSection* Chunk::sectionMesh(int i) const {
+   return m_sectionMeshes.at(i).get();
+}
 
-   this->m_VBOdata_after_transparent.idx = idx_after_transparent;
-   this->m_VBOdata_after_transparent.data = VBOdata_after_transparent;
+void Chunk::copySection(int i, SectionSnapshot &out) const {
+   const int S = SectionSnapshot::SIZE;
+   out.blocks.fill(EMPTY);
+   m_sections[i].decodeInto(&out.blocks[SectionSnapshot::index(0, 0, 0)], S, S * S);
+
+   // The planes of the sections directly below and above
+   for (int z = 0; z < 16; z++) {
+       for (int x = 0; x < 16; x++) {
+           if (i > 0) {
+               out.blocks[SectionSnapshot::index(x, -1, z)] = m_sections[i - 1].get(PalettedSection::index(x, 15, z));
+           }
+           if (i < 15) {
+               out.blocks[SectionSnapshot::index(x, 16, z)] = m_sections[i + 1].get(PalettedSection::index(x, 0, z));
+           }
+       }
+   }
 
+   // The facing planes of the four neighboring Chunks
+   const Chunk *xNeg = m_neighbors.at(XNEG);
+   const Chunk *xPos = m_neighbors.at(XPOS);
+   const Chunk *zNeg = m_neighbors.at(ZNEG);
+   const Chunk *zPos = m_neighbors.at(ZPOS);
+   for (int y = 0; y < 16; y++) {
+       for (int j = 0; j < 16; j++) {
+           if (xNeg != nullptr) {
+               out.blocks[SectionSnapshot::index(-1, y, j)] = xNeg->m_sections[i].get(PalettedSection::index(15, y, j));
+           }
+           if (xPos != nullptr) {
+               out.blocks[SectionSnapshot::index(16, y, j)] = xPos->m_sections[i].get(PalettedSection::index(0, y, j));
+           }
+           if (zNeg != nullptr) {
+               out.blocks[SectionSnapshot::index(j, y, -1)] = zNeg->m_sections[i].get(PalettedSection::index(j, y, 15));
+           }
+           if (zPos != nullptr) {
+               out.blocks[SectionSnapshot::index(j, y, 16)] = zPos->m_sections[i].get(PalettedSection::index(j, y, 0));
+           }
+       }
+   }
+}
 
+void Chunk::markDirty(int y) {
+   m_sectionMeshes[y >> 4]->markDirty();
 }
 
-void Chunk::sendVBOdata() {
+void Chunk::markAllDirty() {
+   for (uPtr<ChunkSection> &section : m_sectionMeshes) {
+       section->markDirty();
+   }
+}
 
+const MeshStats& Chunk::meshStats() const {
+   return m_meshStats;
+}
 
+void Chunk::compactBlocks() {
+   for (PalettedSection &section : m_sections) {
+       section.compact();
+   }
+}
 
-   generateIdx();
-   bindIdx();
-   mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                            this->m_VBOdata.idx.size() * sizeof (GLuint),
-                            this->m_VBOdata.idx.data(),
-                            GL_STATIC_DRAW);
-
-   generateInterleave();
-   bindInterleave();
-   mp_context->glBufferData(GL_ARRAY_BUFFER,
-                            this->m_VBOdata.data.size() * sizeof (glm::vec4),
-                            this->m_VBOdata.data.data(),
-                            GL_STATIC_DRAW);
-
-
-
-   generateIdx_transparent();
-   bindIdx_transparent();
-   mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                            this->m_VBOdata_transparent.idx.size() * sizeof (GLuint),
-                            this->m_VBOdata_transparent.idx.data(),
-                            GL_STATIC_DRAW);
-
-   generateInterleave_transparent();
-   bindInterleave_transparent();
-   mp_context->glBufferData(GL_ARRAY_BUFFER,
-                            this->m_VBOdata_transparent.data.size() * sizeof (glm::vec4),
-                            this->m_VBOdata_transparent.data.data(),
-                            GL_STATIC_DRAW);
-
-   generateIdx_after_transparent();
-   bindIdx_after_transparent();
-   mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                            this->m_VBOdata_after_transparent.idx.size() * sizeof (GLuint),
-                            this->m_VBOdata_after_transparent.idx.data(),
-                            GL_STATIC_DRAW);
-
-   generateInterleave_after_transparent();
-   bindInterleave_after_transparent();
-   mp_context->glBufferData(GL_ARRAY_BUFFER,
-                            this->m_VBOdata_after_transparent.data.size() * sizeof (glm::vec4),
-                            this->m_VBOdata_after_transparent.data.data(),
-                            GL_STATIC_DRAW);
+void Chunk::encodeBlocks(std::vector<uint8_t> &out) const {
+   for (const PalettedSection &section : m_sections) {
+       section.encode(out);
+   }
 }
 
+bool Chunk::decodeBlocks(const uint8_t *data, size_t size) {
+   const uint8_t *end = data + size;
+   std::array<PalettedSection, 16> sections;
+   for (PalettedSection &section : sections) {
+       if (!section.decode(data, end)) {
+           return false;
+       }
+   }
+   if (data != end) {
+       return false;
+   }
+   m_sections = std::move(sections);
+   markAllDirty();
+   m_unsaved = false;
+   return true;
+}
 
-GLenum Chunk::drawMode(){
-   return GL_TRIANGLES;
+bool Chunk::unsaved() const {
+   return m_unsaved;
 }
 
-// Does bounds checking with at()
-BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
-   return m_blocks.at(x + 16 * y + 16 * 256 * z);
+void Chunk::markSaved() {
+   m_unsaved = false;
 }
 
-// Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
-BlockType Chunk::getBlockAt(int x, int y, int z) const {
-   if (y < 0 || y > 255){
-       return EMPTY;
+size_t Chunk::blockMemoryUsage() const {
+   size_t bytes = 0;
+   for (const PalettedSection &section : m_sections) {
+       bytes += section.memoryUsage();
    }
-   return getBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
+   return bytes;
 }
 
-// Does bounds checking with at()
-void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-   m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+std::shared_mutex& Chunk::blocksMutex() const {
+   return m_blocksMutex;
 }
 
 
@@ -366,8 +248,54 @@ const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirectio
 };
 
 void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
+   linkNeighbor(neighbor.get(), dir);
+}
+
+void Chunk::linkNeighbor(Chunk *neighbor, Direction dir) {
    if(neighbor != nullptr) {
-       this->m_neighbors[dir] = neighbor.get();
+       this->m_neighbors[dir] = neighbor;
        neighbor->m_neighbors[oppositeDirection.at(dir)] = this;
    }
 }
+
+void Chunk::unlinkNeighbors() {
+   // Entries are cleared rather than erased, since copySection() expects
+   // every Direction to be there
+   for (auto &[dir, neighbor] : m_neighbors) {
+       if (neighbor != nullptr) {
+           auto back = neighbor->m_neighbors.find(oppositeDirection.at(dir));
+           if (back != neighbor->m_neighbors.end() && back->second == this) {
+               back->second = nullptr;
+           }
+       }
+       neighbor = nullptr;
+   }
+}
+
+void Chunk::queueWrites(std::vector<PendingWrite> writes) {
+   if (writes.empty()) {
+       return;
+   }
+   PendingWriteBatch *batch = new PendingWriteBatch{std::move(writes), m_pendingWrites.load(std::memory_order_relaxed)};
+   while (!m_pendingWrites.compare_exchange_weak(batch->next, batch,
+                                                 std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+void Chunk::applyPendingWrites() {
+   PendingWriteBatch *batch = m_pendingWrites.exchange(nullptr, std::memory_order_acquire);
+   std::vector<PendingWrite> writes;
+   while (batch != nullptr) {
+       writes.insert(writes.end(), batch->writes.begin(), batch->writes.end());
+       PendingWriteBatch *next = batch->next;
+       delete batch;
+       batch = next;
+   }
+   std::sort(writes.begin(), writes.end(), [](const PendingWrite &a, const PendingWrite &b) {
+       return a.type < b.type;
+   });
+   for (const PendingWrite &write : writes) {
+       if (getBlockAt(write.x, write.y, write.z) == EMPTY) {
+           setBlockAt(write.x, write.y, write.z, write.type);
+       }
+   }
+}
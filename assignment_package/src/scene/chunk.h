@@ -4,8 +4,11 @@
 #include <array>
 #include <unordered_map>
 #include <cstddef>
-#include "drawable.h"
-#include <set>
+#include "chunksection.h"
+#include "palettedsection.h"
+#include <shared_mutex>
+#include <atomic>
+#include <vector>
 
 
 //using namespace std;
@@ -121,240 +124,106 @@ const static std::array<BlockFace, 2> diagnalFaces{
               VertexData(glm::vec4(1, 1, 0, 1), glm::vec2(0, BLK_UV)))
 };
 
-static std::set<BlockType> noNormal{
-    WATER, LAVA
-};
-
-static std::set<BlockType> transparentBlock{
-    WATER, CACTUS, LAVA, BAMBOO, ROSE, PAD, ANGELBREATH, YELLOWFLOWER, MUSHROOM, FIRE,
-            MOUNTAINLEAF, CAKE
-
+// What a block is meshed as
+enum BlockShape : unsigned char
+{
+    SHAPE_NONE,   // Nothing to draw (EMPTY)
+    SHAPE_CUBE,   // A full block
+    SHAPE_LIQUID, // Only the top face is drawn
+    SHAPE_PAD,    // Only the top face, lying on the block below
+    SHAPE_CROSS,  // Two diagonal quads, like flowers
+    SHAPE_POST,   // A cube with its faces pulled in, like cactus
+    SHAPE_STALK,  // Pulled-in sides and no top or bottom, like bamboo
+    SHAPE_CAKE    // Half a block tall, with its sides pulled in a little
 };
 
-static std::set<BlockType> usingBetterTexture{
-
-    SAND, PUMPKIN, CACTUS, ROSE, BAMBOO, PAD, ANGELBREATH, YELLOWFLOWER, MUSHROOM, FIRE
-            , WHITETREESTEM, BROWNTREESTEM, MOUNTAINLEAF, CAKE
+enum BlockFlags : unsigned char
+{
+    BLOCK_TRANSPARENT = 1,    // Doesn't hide the faces of the blocks around it
+    BLOCK_LIQUID = 2,         // Can be swum through; drawn with waves and no normal map
+    BLOCK_SOLID = 4,          // Stops the player and the player's ray casts
+    BLOCK_BETTER_TEXTURE = 8, // Sampled from u_textureBetter
+    BLOCK_ANIMATED = 16       // Sways in the wind
 };
 
-static std::set<BlockType> diagnalBlock{
-  ROSE, ANGELBREATH, YELLOWFLOWER, MUSHROOM, FIRE
+// Everything the mesher and the Player need to know about a BlockType.
+// They are all kept in one flat table indexed by BlockType, so a lookup in
+// the meshing loop is a single array load rather than a tree or hash walk.
+struct BlockProperties
+{
+    unsigned char flags;
+    BlockShape shape;
+    // Light given off, from 0 to 15
+    unsigned char emissive;
+    // Atlas tile (column + 16 * row) of each face, in Direction order
+    std::array<unsigned char, 6> tiles;
+
+    constexpr bool has(BlockFlags flag) const {
+        return (flags & flag) != 0;
+    }
 };
 
-static std::unordered_map<BlockType,
-std::unordered_map<Direction, glm::vec2, EnumHash>, EnumHash> blockFaceUV{
-    {GRASS, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)},
-            {XNEG, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)},
-            {YPOS, glm::vec2(8.f BLK_UVX, 13.f BLK_UVY)},
-            {YNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-            {ZPOS, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)},
-            {ZNEG, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)}
-        }},
-    {DIRT, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-            {XNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-            {YPOS, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-            {YNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-            {ZPOS, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-            {ZNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)}
-        }},
-    {STONE, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-            {XNEG, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-            {YPOS, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-            {YNEG, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-            {ZPOS, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-            {ZNEG, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)}
-        }},
-    {WATER, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(14.f BLK_UVX, 2.f BLK_UVY)},
-            {XNEG, glm::vec2(14.f BLK_UVX, 2.f BLK_UVY)},
-            {YPOS, glm::vec2(14.f BLK_UVX, 2.f BLK_UVY)},
-            {YNEG, glm::vec2(14.f BLK_UVX, 2.f BLK_UVY)},
-            {ZPOS, glm::vec2(14.f BLK_UVX, 2.f BLK_UVY)},
-            {ZNEG, glm::vec2(14.f BLK_UVX, 2.f BLK_UVY)}
-        }},
-
-    {SNOW, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(2.f BLK_UVX, 11.f BLK_UVY)},
-            {XNEG, glm::vec2(2.f BLK_UVX, 11.f BLK_UVY)},
-            {YPOS, glm::vec2(2.f BLK_UVX, 11.f BLK_UVY)},
-            {YNEG, glm::vec2(2.f BLK_UVX, 11.f BLK_UVY)},
-            {ZPOS, glm::vec2(2.f BLK_UVX, 11.f BLK_UVY)},
-            {ZNEG, glm::vec2(2.f BLK_UVX, 11.f BLK_UVY)}
-        }},
-    {SAND, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-            {XNEG, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-            {YPOS, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-            {YNEG, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-            {ZPOS, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-            {ZNEG, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)}
-        }},
-    {LAVA, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(14.f BLK_UVX, 0.f BLK_UVY)},
-            {XNEG, glm::vec2(14.f BLK_UVX, 0.f BLK_UVY)},
-            {YPOS, glm::vec2(14.f BLK_UVX, 0.f BLK_UVY)},
-            {YNEG, glm::vec2(14.f BLK_UVX, 0.f BLK_UVY)},
-            {ZPOS, glm::vec2(14.f BLK_UVX, 0.f BLK_UVY)},
-            {ZNEG, glm::vec2(14.f BLK_UVX, 0.f BLK_UVY)}
-        }},
-    {BEDROCK, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-            {XNEG, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-            {YPOS, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-            {YNEG, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-            {ZPOS, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-            {ZNEG, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)}
-        }},
-    {REDSTONE, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(7.f BLK_UVX, 9.f BLK_UVY)},
-            {XNEG, glm::vec2(7.f BLK_UVX, 9.f BLK_UVY)},
-            {YPOS, glm::vec2(7.f BLK_UVX, 9.f BLK_UVY)},
-            {YNEG, glm::vec2(7.f BLK_UVX, 9.f BLK_UVY)},
-            {ZPOS, glm::vec2(7.f BLK_UVX, 9.f BLK_UVY)},
-            {ZNEG, glm::vec2(7.f BLK_UVX, 9.f BLK_UVY)}
-        }},
-    {ICE, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(8.f BLK_UVX, 14.f BLK_UVY)},
-            {XNEG, glm::vec2(8.f BLK_UVX, 14.f BLK_UVY)},
-            {YPOS, glm::vec2(8.f BLK_UVX, 14.f BLK_UVY)},
-            {YNEG, glm::vec2(8.f BLK_UVX, 14.f BLK_UVY)},
-            {ZPOS, glm::vec2(8.f BLK_UVX, 14.f BLK_UVY)},
-            {ZNEG, glm::vec2(8.f BLK_UVX, 14.f BLK_UVY)}
-        }},
-    {ICESTONE, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(2.f BLK_UVX, 12.f BLK_UVY)},
-            {XNEG, glm::vec2(2.f BLK_UVX, 12.f BLK_UVY)},
-            {YPOS, glm::vec2(2.f BLK_UVX, 12.f BLK_UVY)},
-            {YNEG, glm::vec2(2.f BLK_UVX, 12.f BLK_UVY)},
-            {ZPOS, glm::vec2(2.f BLK_UVX, 12.f BLK_UVY)},
-            {ZNEG, glm::vec2(2.f BLK_UVX, 12.f BLK_UVY)}
-        }},
-    {PUMPKIN, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(6.f BLK_UVX, 8.f BLK_UVY)},
-            {XNEG, glm::vec2(6.f BLK_UVX, 8.f BLK_UVY)},
-            {YPOS, glm::vec2(6.f BLK_UVX, 9.f BLK_UVY)},
-            {YNEG, glm::vec2(6.f BLK_UVX, 8.f BLK_UVY)},
-            {ZPOS, glm::vec2(8.f BLK_UVX, 8.f BLK_UVY)},
-            {ZNEG, glm::vec2(8.f BLK_UVX, 8.f BLK_UVY)}
-
-        }},
-    {CACTUS, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)},
-            {XNEG, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)},
-            {YPOS, glm::vec2(5.f BLK_UVX, 11.f BLK_UVY)},
-            {YNEG, glm::vec2(5.f BLK_UVX, 11.f BLK_UVY)},
-            {ZPOS, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)},
-            {ZNEG, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)}
-
-        }},
-    {BAMBOO, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {XNEG, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {YPOS, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {YNEG, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {ZPOS, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {ZNEG, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)}
-
-        }},
-    {BAMBOOBOT, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {XNEG, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {YPOS, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {YNEG, glm::vec2(8.f BLK_UVX, 13.f BLK_UVY)},
-            {ZPOS, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)},
-            {ZNEG, glm::vec2(9.f BLK_UVX, 11.f BLK_UVY)}
-
-        }},
-    {ROSE, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(12.f BLK_UVX, 15.f BLK_UVY)},
-            {XNEG, glm::vec2(12.f BLK_UVX, 15.f BLK_UVY)},
-            {YPOS, glm::vec2(12.f BLK_UVX, 15.f BLK_UVY)},
-            {YNEG, glm::vec2(12.f BLK_UVX, 15.f BLK_UVY)},
-            {ZPOS, glm::vec2(12.f BLK_UVX, 15.f BLK_UVY)},
-            {ZNEG, glm::vec2(12.f BLK_UVX, 15.f BLK_UVY)}
-
-        }},
-    {PAD, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(13.f BLK_UVX, 8.f BLK_UVY)},
-            {XNEG, glm::vec2(13.f BLK_UVX, 8.f BLK_UVY)},
-            {YPOS, glm::vec2(13.f BLK_UVX, 8.f BLK_UVY)},
-            {YNEG, glm::vec2(13.f BLK_UVX, 8.f BLK_UVY)},
-            {ZPOS, glm::vec2(13.f BLK_UVX, 8.f BLK_UVY)},
-            {ZNEG, glm::vec2(13.f BLK_UVX, 8.f BLK_UVY)}
-
-        }},
-    {ANGELBREATH, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(14.f BLK_UVX, 5.f BLK_UVY)},
-            {XNEG, glm::vec2(14.f BLK_UVX, 5.f BLK_UVY)},
-            {YPOS, glm::vec2(14.f BLK_UVX, 5.f BLK_UVY)},
-            {YNEG, glm::vec2(14.f BLK_UVX, 5.f BLK_UVY)},
-            {ZPOS, glm::vec2(14.f BLK_UVX, 5.f BLK_UVY)},
-            {ZNEG, glm::vec2(14.f BLK_UVX, 5.f BLK_UVY)}
-
-        }},
-    {YELLOWFLOWER, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(14.f BLK_UVX, 6.f BLK_UVY)},
-            {XNEG, glm::vec2(14.f BLK_UVX, 6.f BLK_UVY)},
-            {YPOS, glm::vec2(14.f BLK_UVX, 6.f BLK_UVY)},
-            {YNEG, glm::vec2(14.f BLK_UVX, 6.f BLK_UVY)},
-            {ZPOS, glm::vec2(14.f BLK_UVX, 6.f BLK_UVY)},
-            {ZNEG, glm::vec2(14.f BLK_UVX, 6.f BLK_UVY)}
-
-        }},
-    {MUSHROOM, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(12.f BLK_UVX, 14.f BLK_UVY)},
-            {XNEG, glm::vec2(12.f BLK_UVX, 14.f BLK_UVY)},
-            {YPOS, glm::vec2(12.f BLK_UVX, 14.f BLK_UVY)},
-            {YNEG, glm::vec2(12.f BLK_UVX, 14.f BLK_UVY)},
-            {ZPOS, glm::vec2(12.f BLK_UVX, 14.f BLK_UVY)},
-            {ZNEG, glm::vec2(12.f BLK_UVX, 14.f BLK_UVY)}
-        }},
-    {FIRE, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(15.f BLK_UVX, 14.f BLK_UVY)},
-            {XNEG, glm::vec2(15.f BLK_UVX, 14.f BLK_UVY)},
-            {YPOS, glm::vec2(15.f BLK_UVX, 14.f BLK_UVY)},
-            {YNEG, glm::vec2(15.f BLK_UVX, 14.f BLK_UVY)},
-            {ZPOS, glm::vec2(15.f BLK_UVX, 14.f BLK_UVY)},
-            {ZNEG, glm::vec2(15.f BLK_UVX, 14.f BLK_UVY)}
-        }},
-    {WHITETREESTEM, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(5.f BLK_UVX, 8.f BLK_UVY)},
-            {XNEG, glm::vec2(5.f BLK_UVX, 8.f BLK_UVY)},
-            {YPOS, glm::vec2(5.f BLK_UVX, 8.f BLK_UVY)},
-            {YNEG, glm::vec2(5.f BLK_UVX, 8.f BLK_UVY)},
-            {ZPOS, glm::vec2(5.f BLK_UVX, 8.f BLK_UVY)},
-            {ZNEG, glm::vec2(5.f BLK_UVX, 8.f BLK_UVY)}
-        }},
-    {BROWNTREESTEM, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(4.f BLK_UVX, 8.f BLK_UVY)},
-            {XNEG, glm::vec2(4.f BLK_UVX, 8.f BLK_UVY)},
-            {YPOS, glm::vec2(4.f BLK_UVX, 8.f BLK_UVY)},
-            {YNEG, glm::vec2(4.f BLK_UVX, 8.f BLK_UVY)},
-            {ZPOS, glm::vec2(4.f BLK_UVX, 8.f BLK_UVY)},
-            {ZNEG, glm::vec2(4.f BLK_UVX, 8.f BLK_UVY)}
-        }},
-    {MOUNTAINLEAF, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(4.f BLK_UVX, 7.f BLK_UVY)},
-            {XNEG, glm::vec2(4.f BLK_UVX, 7.f BLK_UVY)},
-            {YPOS, glm::vec2(4.f BLK_UVX, 7.f BLK_UVY)},
-            {YNEG, glm::vec2(4.f BLK_UVX, 7.f BLK_UVY)},
-            {ZPOS, glm::vec2(4.f BLK_UVX, 7.f BLK_UVY)},
-            {ZNEG, glm::vec2(4.f BLK_UVX, 7.f BLK_UVY)}
-        }},
-    {CAKE, std::unordered_map<Direction, glm::vec2, EnumHash>{
-            {XPOS, glm::vec2(10.f BLK_UVX, 8.f BLK_UVY)},
-            {XNEG, glm::vec2(10.f BLK_UVX, 8.f BLK_UVY)},
-            {YPOS, glm::vec2(9.f BLK_UVX, 8.f BLK_UVY)},
-            {YNEG, glm::vec2(12.f BLK_UVX, 8.f BLK_UVY)},
-            {ZPOS, glm::vec2(10.f BLK_UVX, 8.f BLK_UVY)},
-            {ZNEG, glm::vec2(10.f BLK_UVX, 8.f BLK_UVY)}
-        }}
-
-
-};
+constexpr unsigned char atlasTileAt(int column, int row) {
+    return static_cast<unsigned char>(column + 16 * row);
+}
+
+// The tiles of a block whose four sides look the same
+constexpr std::array<unsigned char, 6> cubeTiles(unsigned char side, unsigned char top, unsigned char bottom) {
+    return {side, side, top, bottom, side, side};
+}
+
+constexpr std::array<unsigned char, 6> cubeTiles(unsigned char all) {
+    return cubeTiles(all, all, all);
+}
+
+constexpr std::array<BlockProperties, 256> makeBlockTable() {
+    const unsigned char OPAQUE = BLOCK_SOLID;
+    const unsigned char BETTER = BLOCK_SOLID | BLOCK_BETTER_TEXTURE;
+    const unsigned char SEE_THROUGH = BLOCK_SOLID | BLOCK_TRANSPARENT | BLOCK_BETTER_TEXTURE;
+    const unsigned char LIQUID = BLOCK_TRANSPARENT | BLOCK_LIQUID;
+
+    // Types missing from the table are left as opaque, untextured cubes
+    std::array<BlockProperties, 256> table {};
+    table[EMPTY]         = {BLOCK_TRANSPARENT, SHAPE_NONE, 0, {}};
+    table[GRASS]         = {OPAQUE, SHAPE_CUBE, 0,
+                            cubeTiles(atlasTileAt(3, 15), atlasTileAt(8, 13), atlasTileAt(2, 15))};
+    table[DIRT]          = {OPAQUE, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(2, 15))};
+    table[STONE]         = {OPAQUE, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(1, 15))};
+    table[WATER]         = {LIQUID, SHAPE_LIQUID, 0, cubeTiles(atlasTileAt(14, 2))};
+    table[SNOW]          = {OPAQUE, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(2, 11))};
+    table[SAND]          = {BETTER, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(2, 14))};
+    table[LAVA]          = {LIQUID, SHAPE_LIQUID, 15, cubeTiles(atlasTileAt(14, 0))};
+    table[BEDROCK]       = {OPAQUE, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(1, 14))};
+    table[REDSTONE]      = {OPAQUE, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(7, 9))};
+    table[ICE]           = {OPAQUE, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(8, 14))};
+    table[ICESTONE]      = {OPAQUE, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(2, 12))};
+    table[PUMPKIN]       = {BETTER, SHAPE_CUBE, 0,
+                            {atlasTileAt(6, 8), atlasTileAt(6, 8), atlasTileAt(6, 9),
+                             atlasTileAt(6, 8), atlasTileAt(8, 8), atlasTileAt(8, 8)}};
+    table[CACTUS]        = {SEE_THROUGH, SHAPE_POST, 0,
+                            cubeTiles(atlasTileAt(6, 11), atlasTileAt(5, 11), atlasTileAt(5, 11))};
+    table[BAMBOO]        = {SEE_THROUGH, SHAPE_STALK, 0, cubeTiles(atlasTileAt(9, 11))};
+    table[BAMBOOBOT]     = {OPAQUE, SHAPE_CUBE, 0,
+                            cubeTiles(atlasTileAt(9, 11), atlasTileAt(9, 11), atlasTileAt(8, 13))};
+    table[ROSE]          = {SEE_THROUGH, SHAPE_CROSS, 0, cubeTiles(atlasTileAt(12, 15))};
+    table[PAD]           = {SEE_THROUGH, SHAPE_PAD, 0, cubeTiles(atlasTileAt(13, 8))};
+    table[ANGELBREATH]   = {SEE_THROUGH, SHAPE_CROSS, 0, cubeTiles(atlasTileAt(14, 5))};
+    table[YELLOWFLOWER]  = {SEE_THROUGH, SHAPE_CROSS, 0, cubeTiles(atlasTileAt(14, 6))};
+    table[MUSHROOM]      = {SEE_THROUGH, SHAPE_CROSS, 0, cubeTiles(atlasTileAt(12, 14))};
+    table[FIRE]          = {SEE_THROUGH | BLOCK_ANIMATED, SHAPE_CROSS, 15, cubeTiles(atlasTileAt(15, 14))};
+    table[WHITETREESTEM] = {BETTER, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(5, 8))};
+    table[BROWNTREESTEM] = {BETTER, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(4, 8))};
+    table[MOUNTAINLEAF]  = {SEE_THROUGH, SHAPE_CUBE, 0, cubeTiles(atlasTileAt(4, 7))};
+    table[CAKE]          = {SEE_THROUGH, SHAPE_CAKE, 0,
+                            cubeTiles(atlasTileAt(10, 8), atlasTileAt(9, 8), atlasTileAt(12, 8))};
+    return table;
+}
+
+inline constexpr std::array<BlockProperties, 256> blockTable = makeBlockTable();
+
+constexpr const BlockProperties& blockProperties(BlockType t) {
+    return blockTable[t];
+}
 
 // One Chunk is a 16 x 256 x 16 section of the world,
 // containing all the Minecraft blocks in that area.
@@ -362,20 +231,53 @@ std::unordered_map<Direction, glm::vec2, EnumHash>, EnumHash> blockFaceUV{
 // recomputing its VBO data faster by not having to
 // render all the world at once, while also not having
 // to render the world block by block.
+// A Chunk is further split into sixteen 16 x 16 x 16 ChunkSections,
+// each with its own VBOs, so that an edit only remeshes the sections
+// it actually touches.
 
-// TODO have Chunk inherit from Drawable
-
-struct ChunkVBOData
+// Size of a Chunk's mesh and how long its last rebuild took
+struct MeshStats
 {
-    std::vector<GLuint> idx;
-    std::vector<glm::vec4> data;
+    int vertices = 0;
+    int indices = 0;
+    float ms = 0.f;
+    // Heap allocations the last rebuild made for mesh buffers.
+    // Zero once ChunkSection's buffer pool has warmed up.
+    int allocations = 0;
+    long long allocatedBytes = 0;
 };
 
+// A block that a neighboring Chunk's decoration places in this Chunk
+struct PendingWrite
+{
+    unsigned char x, y, z;
+    BlockType type;
+};
 
-class Chunk : public Drawable{
+class Chunk {
 private:
-    // All of the blocks contained within this Chunk
-    std::array<BlockType, 65536> m_blocks;
+    // One queueWrites() call's blocks, linked newest first
+    struct PendingWriteBatch
+    {
+        std::vector<PendingWrite> writes;
+        PendingWriteBatch *next;
+    };
+
+    // All of the blocks contained within this Chunk, stored as sixteen
+    // palette-compressed 16 x 16 x 16 sections stacked along Y
+    std::array<PalettedSection, 16> m_sections;
+    // The mesh of each of those sections
+    std::array<uPtr<ChunkSection>, 16> m_sectionMeshes;
+    // Guards m_sections against being read by a neighbor's VBO worker
+    // while this Chunk is still being filled (or edited) on another thread
+    mutable std::shared_mutex m_blocksMutex;
+    MeshStats m_meshStats;
+    // Set whenever a block changes, and cleared once the blocks have been
+    // handed to WorldStorage or read back from it
+    bool m_unsaved;
+    // Blocks queued by neighbors for applyPendingWrites(), pushed without
+    // a lock while another thread may be filling or meshing this Chunk
+    std::atomic<PendingWriteBatch*> m_pendingWrites;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
@@ -384,26 +286,69 @@ private:
 
 public:
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
+    // Blocks this Chunk's decorations placed in each of its eight
+    // neighbors, indexed by (dx + 1) + 3 * (dz + 1) for the neighbor at
+    // offset (dx, dz). Held here until Terrain hands them on.
+    std::array<std::vector<PendingWrite>, 9> m_spilled;
 
 
     Chunk(OpenGLContext* context, int x, int z);
 
     ~Chunk();
-    void createVBOdata() override;
+    // Rebuilds the mesh of every dirty section
+    void createVBOdata();
+    // Uploads every section rebuilt by the last createVBOdata() call
     void sendVBOdata();
-
-    GLenum drawMode() override;
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
+    // Also marks the section holding (x, y, z) dirty, plus the section
+    // above or below it when y lies on a section boundary
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Sets blocks (x, y0, z) up to but not including (x, y1, z) to t a
+    // section at a time, which is much cheaper than setBlockAt() per block
+    void fillSpan(unsigned int x, unsigned int z, unsigned int y0, unsigned int y1, BlockType t);
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    void linkNeighbor(Chunk *neighbor, Direction dir);
+    // Removes this Chunk from its neighbors' m_neighbors and clears its
+    // own, so it can be deleted without leaving them dangling pointers
+    void unlinkNeighbors();
+
+    const PalettedSection& blockSection(int i) const;
+    ChunkSection* sectionMesh(int i) const;
+    // Copies section i and the blocks bordering it into out.
+    // Missing neighbors, and everything below y = 0 or above y = 255,
+    // read as EMPTY.
+    void copySection(int i, SectionSnapshot &out) const;
+    // Marks the section containing local height y dirty
+    void markDirty(int y);
+    void markAllDirty();
+    const MeshStats& meshStats() const;
+
+    // Shrinks every section's palette to the BlockTypes it still uses
+    void compactBlocks();
+    // Appends every section's PalettedSection::encode() to out
+    void encodeBlocks(std::vector<uint8_t> &out) const;
+    // Replaces the blocks with those encodeBlocks() wrote. Returns false,
+    // changing nothing, if size bytes at data aren't exactly that.
+    bool decodeBlocks(const uint8_t *data, size_t size);
+    // Queues blocks for this Chunk to place the next time its own job calls
+    // applyPendingWrites(). Safe to call from any thread at any time.
+    void queueWrites(std::vector<PendingWrite> writes);
+    // Places the queued blocks that land on EMPTY. Where two land on the
+    // same block the lower BlockType wins, so the result doesn't depend on
+    // which neighbor queued first. Call with blocksMutex() held exclusively.
+    void applyPendingWrites();
+    // Whether any block has changed since the last markSaved()
+    bool unsaved() const;
+    void markSaved();
+    // Bytes currently used to store this Chunk's blocks
+    // (a flat array would use 65536)
+    size_t blockMemoryUsage() const;
+    std::shared_mutex& blocksMutex() const;
 
 
     /*
     Milestone 2
     */
     glm::ivec2 m_pos;
-    ChunkVBOData m_VBOdata;
-    ChunkVBOData m_VBOdata_transparent;
-    ChunkVBOData m_VBOdata_after_transparent;
 };
@@ -0,0 +1,72 @@
+#include "chunkgrid.h"
+#include "chunk.h"
+#include <algorithm>
+
+ChunkGrid::ChunkGrid()
+    : m_cells(), m_minX(-SIZE / 2), m_minZ(-SIZE / 2)
+{
+    for (std::atomic<Chunk*> &cell : m_cells) {
+        cell.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+int ChunkGrid::cellIndex(int cx, int cz) {
+    return (cx & MASK) | ((cz & MASK) << SIZE_LOG2);
+}
+
+bool ChunkGrid::contains(int cx, int cz) const {
+    // One unsigned compare per axis covers both ends of the range
+    return static_cast<unsigned int>(cx - m_minX.load(std::memory_order_relaxed)) < static_cast<unsigned int>(SIZE) &&
+           static_cast<unsigned int>(cz - m_minZ.load(std::memory_order_relaxed)) < static_cast<unsigned int>(SIZE);
+}
+
+Chunk* ChunkGrid::find(int cx, int cz) const {
+    if (!contains(cx, cz)) {
+        return nullptr;
+    }
+    Chunk *chunk = m_cells[cellIndex(cx, cz)].load(std::memory_order_acquire);
+    // The cell may still hold a Chunk that just left the window
+    if (chunk == nullptr || chunk->m_pos.x != 16 * cx || chunk->m_pos.y != 16 * cz) {
+        return nullptr;
+    }
+    return chunk;
+}
+
+void ChunkGrid::set(int cx, int cz, Chunk *chunk) {
+    if (contains(cx, cz)) {
+        m_cells[cellIndex(cx, cz)].store(chunk, std::memory_order_release);
+    }
+}
+
+void ChunkGrid::recenter(int cx, int cz, const std::function<Chunk*(int, int)> &lookup) {
+    int oldMinX = m_minX.load(std::memory_order_relaxed);
+    int oldMinZ = m_minZ.load(std::memory_order_relaxed);
+    int minX = cx - SIZE / 2;
+    int minZ = cz - SIZE / 2;
+    if (minX == oldMinX && minZ == oldMinZ) {
+        return;
+    }
+    m_minX.store(minX, std::memory_order_relaxed);
+    m_minZ.store(minZ, std::memory_order_relaxed);
+
+    auto fill = [&](int x, int z) {
+        m_cells[cellIndex(x, z)].store(lookup(x, z), std::memory_order_release);
+    };
+    // Columns that weren't in the old window at all
+    for (int x = minX; x < minX + SIZE; x++) {
+        if (x >= oldMinX && x < oldMinX + SIZE) {
+            continue;
+        }
+        for (int z = minZ; z < minZ + SIZE; z++) {
+            fill(x, z);
+        }
+    }
+    // and the new rows of the columns that were
+    int enterZ = minZ > oldMinZ ? std::max(minZ, oldMinZ + SIZE) : minZ;
+    int endZ = minZ > oldMinZ ? minZ + SIZE : std::min(oldMinZ, minZ + SIZE);
+    for (int x = std::max(minX, oldMinX); x < std::min(minX, oldMinX) + SIZE; x++) {
+        for (int z = enterZ; z < endZ; z++) {
+            fill(x, z);
+        }
+    }
+}
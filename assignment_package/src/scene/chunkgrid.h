@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <functional>
+
+class Chunk;
+
+// Pointers to the Chunks in a square window of SIZE x SIZE Chunks around
+// the player, stored as a ring: the Chunk at Chunk coordinates (cx, cz)
+// (its block coordinates divided by 16) lives in cell (cx & MASK, cz & MASK)
+// for as long as the window covers it. A lookup is a couple of shifts,
+// masks and compares instead of a hash map probe, and moving the window
+// only refills the cells of the rows and columns that enter it.
+// Cells are atomic and every hit is checked against the Chunk's own
+// position, so other threads may call find() while the main thread moves
+// the window or adds Chunks. Such a reader can briefly miss a Chunk that
+// is entering the window, but never gets the wrong one.
+// Chunks outside the window are not tracked here; Terrain looks them up
+// in its map instead.
+class ChunkGrid
+{
+public:
+    static const int SIZE_LOG2 = 6;
+    static const int SIZE = 1 << SIZE_LOG2;
+    static const int MASK = SIZE - 1;
+
+private:
+    std::array<std::atomic<Chunk*>, SIZE * SIZE> m_cells;
+    // Chunk coordinates of the window's lowest corner
+    std::atomic<int> m_minX;
+    std::atomic<int> m_minZ;
+
+    static int cellIndex(int cx, int cz);
+
+public:
+    ChunkGrid();
+
+    // Whether (cx, cz) is inside the window
+    bool contains(int cx, int cz) const;
+    // The Chunk at (cx, cz), or nullptr if there is none or (cx, cz) is
+    // outside the window
+    Chunk* find(int cx, int cz) const;
+    // Stores chunk at (cx, cz) if that is inside the window. Main thread only.
+    void set(int cx, int cz, Chunk *chunk);
+    // Moves the window so that it is centered on (cx, cz), filling the
+    // cells that enter it with lookup(cx, cz). Main thread only.
+    void recenter(int cx, int cz, const std::function<Chunk*(int, int)> &lookup);
+};
@@ -0,0 +1,200 @@
+#include "chunkscheduler.h"
+#include "chunk.h"
+#include <algorithm>
+
+// std::push_heap keeps the largest element on top, so compare backwards
+static bool runsLater(float a, float b) {
+    return a > b;
+}
+
+ChunkScheduler::ChunkScheduler(WorkerPool &pool, Runner runner)
+    : m_pool(pool), m_runner(runner), m_mutex(), m_queue(), m_parked(), m_running(),
+      m_playerPos(0.f), m_playerForward(0.f, 1.f), m_sequence(0),
+      m_prioritized(true), m_cancelled(0)
+{}
+
+float ChunkScheduler::priority(const Job &job) const {
+    if (!m_prioritized) {
+        return static_cast<float>(job.sequence);
+    }
+    glm::vec2 center = glm::vec2(job.chunk->m_pos) + glm::vec2(8.f);
+    glm::vec2 offset = center - m_playerPos;
+    float distance = glm::length(offset);
+    // 0 straight ahead up to 1 straight behind
+    float behind = distance > 0.f ? (1.f - glm::dot(offset / distance, m_playerForward)) / 2.f : 0.f;
+    float p = distance * (1.f + 2.f * behind);
+    // Finish meshing and decorating Chunks that are already generated
+    // before starting on new ones at the same distance
+    if (job.type == MESH) {
+        return p / 2.f;
+    }
+    return job.type == DECORATE ? p * 0.75f : p;
+}
+
+void ChunkScheduler::schedule(Chunk *chunk, JobType type) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Job job{chunk, type, 0.f, m_sequence++};
+        job.priority = priority(job);
+        m_queue.push_back(job);
+        std::push_heap(m_queue.begin(), m_queue.end(), [](const Job &a, const Job &b) {
+            return runsLater(a.priority, b.priority);
+        });
+    }
+    m_pool.submit([this] { runNext(); });
+}
+
+void ChunkScheduler::runNext() {
+    Job job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // The job this task was submitted for may have been parked
+        if (m_queue.empty()) {
+            return;
+        }
+        std::pop_heap(m_queue.begin(), m_queue.end(), [](const Job &a, const Job &b) {
+            return runsLater(a.priority, b.priority);
+        });
+        job = m_queue.back();
+        m_queue.pop_back();
+        m_running.push_back(job.chunk);
+    }
+    m_runner(job.chunk, job.type);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto running = std::find(m_running.begin(), m_running.end(), job.chunk);
+    *running = m_running.back();
+    m_running.pop_back();
+}
+
+void ChunkScheduler::reprioritize(glm::vec3 position, glm::vec3 forward, float resumeRadius, float cancelRadius) {
+    int resumed = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_playerPos = glm::vec2(position.x, position.z);
+        glm::vec2 flatForward(forward.x, forward.z);
+        if (glm::length(flatForward) > 0.001f) {
+            m_playerForward = glm::normalize(flatForward);
+        }
+
+        auto distance = [this](const Job &job) {
+            return glm::length(glm::vec2(job.chunk->m_pos) + glm::vec2(8.f) - m_playerPos);
+        };
+        for (int i = 0; i < static_cast<int>(m_queue.size());) {
+            if (distance(m_queue[i]) > cancelRadius) {
+                m_parked.push_back(m_queue[i]);
+                m_queue[i] = m_queue.back();
+                m_queue.pop_back();
+            } else {
+                m_queue[i].priority = priority(m_queue[i]);
+                i++;
+            }
+        }
+        for (int i = 0; i < static_cast<int>(m_parked.size());) {
+            if (distance(m_parked[i]) <= resumeRadius) {
+                m_parked[i].priority = priority(m_parked[i]);
+                m_queue.push_back(m_parked[i]);
+                m_parked[i] = m_parked.back();
+                m_parked.pop_back();
+                resumed++;
+            } else {
+                i++;
+            }
+        }
+        std::make_heap(m_queue.begin(), m_queue.end(), [](const Job &a, const Job &b) {
+            return runsLater(a.priority, b.priority);
+        });
+    }
+    // Parking left spare tasks in the pool, but they may already have run
+    // and found nothing, so give each resumed job a task of its own
+    for (int i = 0; i < resumed; i++) {
+        m_pool.submit([this] { runNext(); });
+    }
+}
+
+void ChunkScheduler::setPrioritized(bool prioritized) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prioritized = prioritized;
+}
+
+bool ChunkScheduler::prioritized() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_prioritized;
+}
+
+std::vector<Chunk*> ChunkScheduler::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Chunk*> chunks;
+    for (const Job &job : m_queue) {
+        chunks.push_back(job.chunk);
+    }
+    for (const Job &job : m_parked) {
+        chunks.push_back(job.chunk);
+    }
+    m_queue.clear();
+    m_parked.clear();
+    return chunks;
+}
+
+bool ChunkScheduler::busy(const std::vector<Chunk*> &chunks, const std::vector<Chunk*> &neighbors) const {
+    auto contains = [](const std::vector<Chunk*> &list, Chunk *chunk) {
+        return std::find(list.begin(), list.end(), chunk) != list.end();
+    };
+    auto hasJob = [](const std::vector<Job> &jobs, Chunk *chunk) {
+        return std::find_if(jobs.begin(), jobs.end(), [chunk](const Job &job) {
+            return job.chunk == chunk;
+        }) != jobs.end();
+    };
+    // A Chunk whose job is running, or has finished and handed it on, is
+    // still in use
+    for (Chunk *chunk : chunks) {
+        if (!hasJob(m_queue, chunk) && !hasJob(m_parked, chunk)) {
+            return true;
+        }
+    }
+    for (Chunk *chunk : m_running) {
+        if (contains(neighbors, chunk)) {
+            return true;
+        }
+    }
+    for (const Job &job : m_queue) {
+        if (contains(neighbors, job.chunk)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ChunkScheduler::cancel(const std::vector<Chunk*> &chunks, const std::vector<Chunk*> &neighbors) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (busy(chunks, neighbors)) {
+        return false;
+    }
+    // The pool tasks submitted for removed queued jobs find nothing, or
+    // another job, when they run
+    for (std::vector<Job> *jobs : {&m_queue, &m_parked}) {
+        auto removed = std::remove_if(jobs->begin(), jobs->end(), [&chunks](const Job &job) {
+            return std::find(chunks.begin(), chunks.end(), job.chunk) != chunks.end();
+        });
+        m_cancelled += static_cast<int>(jobs->end() - removed);
+        jobs->erase(removed, jobs->end());
+    }
+    std::make_heap(m_queue.begin(), m_queue.end(), [](const Job &a, const Job &b) {
+        return runsLater(a.priority, b.priority);
+    });
+    return true;
+}
+
+bool ChunkScheduler::canCancel(const std::vector<Chunk*> &chunks, const std::vector<Chunk*> &neighbors) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !busy(chunks, neighbors);
+}
+
+ChunkScheduler::Stats ChunkScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats s;
+    s.queued = static_cast<int>(m_queue.size());
+    s.parked = static_cast<int>(m_parked.size());
+    s.cancelled = m_cancelled;
+    return s;
+}
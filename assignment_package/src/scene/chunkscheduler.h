@@ -0,0 +1,99 @@
+#pragma once
+#include "glm_includes.h"
+#include "workerpool.h"
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class Chunk;
+
+// Orders the generation, decoration and meshing jobs of Chunks so that the
+// ones the player is about to see run first.
+// A job's priority is its Chunk's distance from the player, stretched up to
+// three times for Chunks behind the view direction. Each job adds one task
+// to the WorkerPool, but the task runs whichever queued job has the best
+// priority when a thread gets to it, so reprioritize() reorders every job
+// that hasn't started yet.
+// Jobs whose Chunk drifts out of range are parked instead of run, and go
+// back in the queue if the player returns. A parked Chunk keeps the blocks
+// it has so far until the player comes back, or until cancel() removes the
+// job, which hands the Chunk back to be freed.
+class ChunkScheduler
+{
+public:
+    enum JobType
+    {
+        GENERATE, DECORATE, MESH
+    };
+    using Runner = std::function<void(Chunk*, JobType)>;
+
+    struct Stats
+    {
+        int queued = 0;
+        int parked = 0;
+        // Jobs cancel() removed since the scheduler started
+        int cancelled = 0;
+    };
+
+private:
+    struct Job
+    {
+        Chunk *chunk;
+        JobType type;
+        // Lower runs sooner
+        float priority;
+        // Order of schedule() calls, used when prioritizing is off
+        long long sequence;
+    };
+
+    WorkerPool &m_pool;
+    Runner m_runner;
+
+    // Guards everything below, since workers pop jobs while the main
+    // thread adds and reorders them
+    mutable std::mutex m_mutex;
+    // A heap on priority
+    std::vector<Job> m_queue;
+    std::vector<Job> m_parked;
+    // The Chunk of each job a thread is running, once per job
+    std::vector<Chunk*> m_running;
+    glm::vec2 m_playerPos;
+    glm::vec2 m_playerForward;
+    long long m_sequence;
+    bool m_prioritized;
+    int m_cancelled;
+
+    float priority(const Job &job) const;
+    // Runs the best job in m_queue, if there still is one
+    void runNext();
+    // Whether one of chunks has no queued or parked job, or a job on one
+    // of neighbors is queued or running. Call with m_mutex held.
+    bool busy(const std::vector<Chunk*> &chunks, const std::vector<Chunk*> &neighbors) const;
+
+public:
+    ChunkScheduler(WorkerPool &pool, Runner runner);
+
+    // Queues a job. The job owns chunk until runner is called with it.
+    void schedule(Chunk *chunk, JobType type);
+    // Reprioritizes every queued job for a player at position facing
+    // forward. Parks those whose Chunk center is further than cancelRadius
+    // blocks away, and queues parked jobs again once they're back within
+    // resumeRadius.
+    void reprioritize(glm::vec3 position, glm::vec3 forward, float resumeRadius, float cancelRadius);
+    // Switches between priority order and first-come, first-served
+    void setPrioritized(bool prioritized);
+    bool prioritized() const;
+    // Removes every queued and parked job, returning their Chunks
+    std::vector<Chunk*> clear();
+    // Removes the queued and parked jobs of chunks, so the caller owns them
+    // again and may free them. Does nothing and returns false if one of
+    // chunks has no such job, because it is running or has already handed
+    // its Chunk on, or if a job on neighbors is queued or running, since
+    // those read and write their neighbors. Parked jobs on neighbors don't
+    // count: only reprioritize() resumes them.
+    bool cancel(const std::vector<Chunk*> &chunks, const std::vector<Chunk*> &neighbors);
+    // Whether cancel() would succeed right now
+    bool canCancel(const std::vector<Chunk*> &chunks, const std::vector<Chunk*> &neighbors) const;
+
+    Stats stats() const;
+};
@@ -0,0 +1,518 @@
+#include "chunksection.h"
+#include "chunk.h"
+#include <algorithm>
+
+std::atomic<bool> ChunkSection::s_greedyMeshing(false);
+QuadIndexBuffer ChunkSection::s_quadIndices;
+MeshBufferPool<PackedVertex> ChunkSection::s_bufferPool;
+// 4 MB pages
+MeshArena ChunkSection::s_meshArena(sizeof(PackedVertex), 1 << 19);
+
+ChunkSection::ChunkSection(OpenGLContext* context, Chunk* chunk, int index)
+    : Drawable(context), mp_chunk(chunk), m_index(index),
+      m_dirty(true), m_skipped(false), m_hasPendingData(false),
+      m_VBOdata(), m_VBOdata_transparent(), m_block(-1), m_block_transparent(-1),
+      m_vertexCount(0), m_vertexCount_transparent(0),
+      m_minY(1), m_maxY(0), m_pendingMinY(1), m_pendingMaxY(0),
+      m_visibility(SectionVisibility::all()), m_pendingVisibility(SectionVisibility::all()),
+      m_reachedFrame(0)
+{}
+
+ChunkSection::~ChunkSection() {
+    releaseVBOdata();
+    s_meshArena.release(m_block);
+    s_meshArena.release(m_block_transparent);
+}
+
+static bool isOpaque(BlockType t) {
+    return !blockProperties(t).has(BLOCK_TRANSPARENT);
+}
+
+static bool isUniformOpaque(const PalettedSection &section) {
+    return section.isUniform() && isOpaque(section.get(0));
+}
+
+static unsigned int vertexFlags(const BlockProperties &block) {
+    unsigned int flags = 0;
+    if (block.has(BLOCK_BETTER_TEXTURE)) {
+        flags |= VERTEX_BETTER_TEXTURE;
+    }
+    if (block.has(BLOCK_LIQUID)) {
+        flags |= VERTEX_NO_NORMAL;
+    }
+    if (block.has(BLOCK_ANIMATED)) {
+        flags |= VERTEX_ANIMATED;
+    }
+    return flags;
+}
+
+// Packs one vertex in the layout lambert.vert.glsl unpacks
+static PackedVertex packVertex(glm::ivec3 pos, Direction dir, FaceInset inset, bool sink,
+                               glm::ivec2 uv, unsigned int tile, unsigned int flags) {
+    PackedVertex v;
+    v.posDir = GLuint(pos.x) | GLuint(pos.y) << 5 | GLuint(pos.z) << 14 |
+               GLuint(dir) << 19 | GLuint(inset) << 22 | GLuint(sink) << 24;
+    v.texFlags = GLuint(uv.x) | GLuint(uv.y) << 5 | tile << 10 | flags << 18;
+    return v;
+}
+
+// Appends the quad of one block face, positioned at cell
+static void appendFace(MeshBuffer<PackedVertex> &data,
+                       const BlockFace &face, glm::ivec3 cell, BlockType t,
+                       FaceInset inset = INSET_NONE, bool sink = false) {
+    const BlockProperties &block = blockProperties(t);
+    unsigned int tile = block.tiles[face.direction];
+    unsigned int flags = vertexFlags(block);
+    for (const VertexData &vertex : face.vertices) {
+        glm::ivec2 uv = glm::ivec2(glm::round(vertex.m_uv / float(BLK_UV)));
+        data.push_back(packVertex(cell + glm::ivec3(vertex.m_pos), face.direction, inset, sink,
+                                  uv, tile, flags));
+    }
+}
+
+bool ChunkSection::isHiddenInterior() const {
+    if (!isUniformOpaque(mp_chunk->blockSection(m_index))) {
+        return false;
+    }
+    // Chunk::getBlockAt treats everything below y = 0 and above y = 255 as
+    // EMPTY, so the top and bottom sections always have an exposed face
+    if (m_index == 0 || m_index == 15) {
+        return false;
+    }
+    if (!isUniformOpaque(mp_chunk->blockSection(m_index - 1)) ||
+            !isUniformOpaque(mp_chunk->blockSection(m_index + 1))) {
+        return false;
+    }
+    for (auto &[dir, neighbor] : mp_chunk->m_neighbors) {
+        // A missing neighbor is meshed as if it were air
+        if (neighbor == nullptr || !isUniformOpaque(neighbor->blockSection(m_index))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SectionVisibility ChunkSection::computeVisibility(const SectionSnapshot &snapshot) {
+    // Index offset to each neighboring block, in Direction order
+    static const std::array<int, 6> step {
+        1, -1, 16, -16, 256, -256
+    };
+    thread_local std::array<bool, 4096> open;
+    thread_local std::array<bool, 4096> visited;
+    thread_local std::array<short, 4096> stack;
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 16; y++) {
+            int i = SectionSnapshot::index(0, y, z);
+            for (int x = 0; x < 16; x++, i++) {
+                open[x + 16 * y + 256 * z] = !isOpaque(snapshot.blocks[i]);
+            }
+        }
+    }
+    visited.fill(false);
+
+    SectionVisibility visibility = SectionVisibility::none();
+    // Only regions that touch a face matter, so only start fills from there
+    for (int seed = 0; seed < 4096; seed++) {
+        int sx = seed & 15, sy = (seed >> 4) & 15, sz = seed >> 8;
+        bool onFace = sx == 0 || sx == 15 || sy == 0 || sy == 15 || sz == 0 || sz == 15;
+        if (!onFace || !open[seed] || visited[seed]) {
+            continue;
+        }
+        // Bit d is set once the region reaches face d
+        int faces = 0;
+        int top = 0;
+        stack[top++] = seed;
+        visited[seed] = true;
+        while (top > 0) {
+            int cell = stack[--top];
+            int c[3] = {cell & 15, (cell >> 4) & 15, cell >> 8};
+            for (int d = 0; d < 6; d++) {
+                // Directions come in +/- pairs along x, y and z
+                int axis = d / 2;
+                bool positive = d % 2 == 0;
+                if (c[axis] == (positive ? 15 : 0)) {
+                    faces |= 1 << d;
+                    continue;
+                }
+                int next = cell + step[d];
+                if (open[next] && !visited[next]) {
+                    visited[next] = true;
+                    stack[top++] = next;
+                }
+            }
+        }
+        for (int a = 0; a < 6; a++) {
+            for (int b = a; b < 6; b++) {
+                if ((faces >> a & 1) && (faces >> b & 1)) {
+                    visibility.connect(a, b);
+                }
+            }
+        }
+    }
+    return visibility;
+}
+
+// Index offset to the neighbor across each face, in Direction order
+static const std::array<int, 6> neighborOffset {
+    1, -1,
+    SectionSnapshot::SIZE, -SectionSnapshot::SIZE,
+    SectionSnapshot::SIZE * SectionSnapshot::SIZE, -SectionSnapshot::SIZE * SectionSnapshot::SIZE
+};
+
+void ChunkSection::createGreedyOpaque(const SectionSnapshot &snapshot, MeshBuffer<PackedVertex> &VBOdata) const {
+    const int minY = 16 * m_index;
+    // The BlockType whose face is exposed at each cell of the current layer,
+    // or EMPTY if there is no opaque face there
+    std::array<BlockType, 256> mask;
+
+    for (const BlockFace &face : adjacentFaces) {
+        // n is the axis the face points along, a and b span the face's plane
+        int n = face.directionVec.x != 0 ? 0 : (face.directionVec.y != 0 ? 1 : 2);
+        int a = (n + 1) % 3;
+        int b = (n + 2) % 3;
+        // Which axes the texture's u and v run along on this face
+        glm::vec3 uDir = glm::vec3(face.vertices[1].m_pos - face.vertices[0].m_pos);
+        glm::vec3 vDir = glm::vec3(face.vertices[3].m_pos - face.vertices[0].m_pos);
+        int uAxis = uDir.x != 0 ? 0 : (uDir.y != 0 ? 1 : 2);
+        int vAxis = vDir.x != 0 ? 0 : (vDir.y != 0 ? 1 : 2);
+
+        for (int layer = 0; layer < 16; layer++) {
+            for (int j = 0; j < 16; j++) {
+                for (int i = 0; i < 16; i++) {
+                    glm::ivec3 p;
+                    p[n] = layer;
+                    p[a] = i;
+                    p[b] = j;
+                    int cell = SectionSnapshot::index(p.x, p.y, p.z);
+                    BlockType current = snapshot.blocks[cell];
+                    BlockType neighborType = snapshot.blocks[cell + neighborOffset[face.direction]];
+                    bool exposed = isOpaque(current) && !isOpaque(neighborType);
+                    mask[i + 16 * j] = exposed ? current : EMPTY;
+                }
+            }
+
+            for (int j = 0; j < 16; j++) {
+                for (int i = 0; i < 16; ) {
+                    BlockType current = mask[i + 16 * j];
+                    if (current == EMPTY) {
+                        i++;
+                        continue;
+                    }
+                    // Grow along a as far as possible, then along b
+                    // as long as every cell of the next row matches
+                    int w = 1;
+                    while (i + w < 16 && mask[i + w + 16 * j] == current) {
+                        w++;
+                    }
+                    int h = 1;
+                    for (; j + h < 16; h++) {
+                        bool rowMatches = true;
+                        for (int k = 0; k < w; k++) {
+                            if (mask[i + k + 16 * (j + h)] != current) {
+                                rowMatches = false;
+                                break;
+                            }
+                        }
+                        if (!rowMatches) {
+                            break;
+                        }
+                    }
+                    for (int dj = 0; dj < h; dj++) {
+                        for (int di = 0; di < w; di++) {
+                            mask[i + di + 16 * (j + dj)] = EMPTY;
+                        }
+                    }
+
+                    glm::ivec3 corner, size;
+                    corner[n] = layer;
+                    corner[a] = i;
+                    corner[b] = j;
+                    corner.y += minY;
+                    size[n] = 1;
+                    size[a] = w;
+                    size[b] = h;
+
+                    // The texture coordinates count blocks across the face, so
+                    // lambert.frag.glsl repeats the tile once per block rather
+                    // than stretching it
+                    const BlockProperties &block = blockProperties(current);
+                    unsigned int tile = block.tiles[face.direction];
+                    unsigned int flags = vertexFlags(block);
+                    for (const VertexData &vertex : face.vertices) {
+                        glm::ivec3 unit = glm::ivec3(vertex.m_pos);
+                        glm::ivec2 uv = glm::ivec2(glm::round(vertex.m_uv / float(BLK_UV)));
+                        VBOdata.push_back(packVertex(corner + unit * size, face.direction, INSET_NONE, false,
+                                                     glm::ivec2(uv.x * size[uAxis], uv.y * size[vAxis]),
+                                                     tile, flags));
+                    }
+
+                    i += w;
+                }
+            }
+        }
+    }
+}
+
+// Room for the last mesh plus a few blocks' worth of faces, so that small
+// edits don't outgrow the buffer
+static size_t estimateCapacity(int lastVertexCount) {
+    return lastVertexCount + lastVertexCount / 4 + 4 * 24;
+}
+
+void ChunkSection::createVBOdata() {
+    releaseVBOdata();
+
+    const PalettedSection &blocks = mp_chunk->blockSection(m_index);
+    m_skipped = (blocks.isUniform() && blocks.get(0) == EMPTY) || isHiddenInterior();
+
+    MeshBuffer<PackedVertex> VBOdata;
+    MeshBuffer<PackedVertex> VBOdata_transparent;
+    if (!m_skipped) {
+        VBOdata = s_bufferPool.acquire(estimateCapacity(m_vertexCount));
+        VBOdata_transparent = s_bufferPool.acquire(estimateCapacity(m_vertexCount_transparent));
+    }
+
+    int minY = 16 * m_index;
+
+    // The snapshot is large, so keep one per meshing thread
+    thread_local SectionSnapshot snapshot;
+    if (!m_skipped) {
+        mp_chunk->copySection(m_index, snapshot);
+    }
+    bool greedy = s_greedyMeshing;
+    if (greedy && !m_skipped) {
+        createGreedyOpaque(snapshot, VBOdata);
+    }
+
+    for (int z = 0; z < 16 && !m_skipped; z++){
+        for (int y = 0; y < 16; y++){
+            int snapshotIdx = SectionSnapshot::index(0, y, z);
+            for (int x = 0; x < 16; x++, snapshotIdx++){
+
+                BlockType current = snapshot.blocks[snapshotIdx];
+                glm::ivec3 currentPos = glm::ivec3(x, minY + y, z);
+                // Opaque faces were already emitted by createGreedyOpaque()
+                if (current != EMPTY && !(greedy && isOpaque(current))){
+                    const BlockProperties &block = blockProperties(current);
+
+                    for (const BlockFace &neighborFace : adjacentFaces){
+                        if (block.shape == SHAPE_STALK &&
+                                (neighborFace.direction == YPOS || neighborFace.direction == YNEG)){
+                            continue;
+                        }
+                        // Pads and liquids only show their top face
+                        if ((block.shape == SHAPE_PAD || block.shape == SHAPE_LIQUID) &&
+                                neighborFace.direction != YPOS){
+                            continue;
+                        }
+                        BlockType neighborType = snapshot.blocks[snapshotIdx + neighborOffset[neighborFace.direction]];
+
+                        if (!block.has(BLOCK_TRANSPARENT)) {
+                            if (blockProperties(neighborType).has(BLOCK_TRANSPARENT)){
+                                appendFace(VBOdata, neighborFace, currentPos, current);
+                            }
+                       }
+                       else  { // Current block is transparent, don't put walls b/t water but do b/t different transp block types
+                            if (current != WATER || (neighborType == EMPTY || neighborType == PAD)){
+                                if (block.shape != SHAPE_CROSS){
+                                    // Thin and short blocks pull their faces in
+                                    // from the edges of the block
+                                    FaceInset inset = INSET_NONE;
+                                    bool sink = false;
+                                    glm::ivec3 pos = currentPos;
+                                    if (block.shape == SHAPE_POST || block.shape == SHAPE_STALK){
+                                        inset = INSET_FIFTH;
+                                    }else if (block.shape == SHAPE_CAKE && neighborFace.direction == YPOS){
+                                        inset = INSET_HALF;
+                                    }else if (block.shape == SHAPE_CAKE && neighborFace.direction != YNEG){
+                                        inset = INSET_TENTH;
+                                        sink = true;
+                                    }else if (block.shape == SHAPE_PAD){
+                                        pos.y -= 1;
+                                    }
+                                    appendFace(VBOdata_transparent, neighborFace, pos, current, inset, sink);
+                                }else{
+                                    int diagIdx;
+                                    if (neighborFace.direction == XPOS){
+                                        diagIdx = 0;
+                                    }else if (neighborFace.direction == XNEG){
+                                        diagIdx = 1;
+                                    }else{
+                                        continue;
+                                    }
+                                    appendFace(VBOdata_transparent, diagnalFaces[diagIdx], currentPos, current);
+                                }
+                            }
+                       }
+
+                    }
+
+                }
+            }
+        }
+    }
+
+    m_vertexCount = VBOdata.size();
+    m_vertexCount_transparent = VBOdata_transparent.size();
+
+    if (!m_skipped) {
+        m_pendingVisibility = computeVisibility(snapshot);
+    } else if (blocks.isUniform() && blocks.get(0) == EMPTY) {
+        m_pendingVisibility = SectionVisibility::all();
+    } else {
+        m_pendingVisibility = SectionVisibility::none();
+    }
+
+    m_pendingMinY = 256;
+    m_pendingMaxY = 0;
+    for (const MeshBuffer<PackedVertex> *mesh : {&VBOdata, &VBOdata_transparent}) {
+        for (const PackedVertex &vertex : *mesh) {
+            int y = (vertex.posDir >> 5) & 511;
+            m_pendingMinY = std::min(m_pendingMinY, y);
+            m_pendingMaxY = std::max(m_pendingMaxY, y);
+        }
+    }
+
+    // Don't hold on to capacity for a mesh with nothing in it
+    if (VBOdata.empty()) {
+        s_bufferPool.release(std::move(VBOdata));
+    }
+    if (VBOdata_transparent.empty()) {
+        s_bufferPool.release(std::move(VBOdata_transparent));
+    }
+    this->m_VBOdata.data = std::move(VBOdata);
+    this->m_VBOdata_transparent.data = std::move(VBOdata_transparent);
+
+    m_hasPendingData = true;
+}
+
+void ChunkSection::sendVBOdata() {
+    if (!m_hasPendingData) {
+        return;
+    }
+
+    int quads = this->m_VBOdata.data.size() / 4;
+    int quads_transparent = this->m_VBOdata_transparent.data.size() / 4;
+    s_quadIndices.reserve(mp_context, std::max(quads, quads_transparent));
+
+    m_block = s_meshArena.upload(mp_context, m_block,
+                                 this->m_VBOdata.data.data(), this->m_VBOdata.data.size(), mp_chunk->m_pos);
+    m_block_transparent = s_meshArena.upload(mp_context, m_block_transparent,
+                                             this->m_VBOdata_transparent.data.data(),
+                                             this->m_VBOdata_transparent.data.size(), mp_chunk->m_pos);
+
+    // The counts only change once the GPU has the matching buffers
+    this->m_count = 6 * quads;
+    this->m_count_transparent = 6 * quads_transparent;
+    m_minY = m_pendingMinY;
+    m_maxY = m_pendingMaxY;
+    m_visibility = m_pendingVisibility;
+
+    // The GPU holds its own copy now
+    releaseVBOdata();
+}
+
+void ChunkSection::releaseVBOdata() {
+    if (!m_hasPendingData) {
+        return;
+    }
+    s_bufferPool.release(std::move(this->m_VBOdata.data));
+    s_bufferPool.release(std::move(this->m_VBOdata_transparent.data));
+    m_hasPendingData = false;
+}
+
+bool ChunkSection::bindIdx() {
+    return s_quadIndices.bind(mp_context);
+}
+
+bool ChunkSection::bindIdx_transparent() {
+    return s_quadIndices.bind(mp_context);
+}
+
+GLenum ChunkSection::idxType() {
+    return s_quadIndices.type();
+}
+
+bool ChunkSection::bindInterleave() {
+    return s_meshArena.bind(mp_context, m_block);
+}
+
+bool ChunkSection::bindInterleave_transparent() {
+    return s_meshArena.bind(mp_context, m_block_transparent);
+}
+
+int ChunkSection::baseVertex() {
+    return s_meshArena.baseVertex(m_block);
+}
+
+int ChunkSection::baseVertex_transparent() {
+    return s_meshArena.baseVertex(m_block_transparent);
+}
+
+void ChunkSection::markDirty() {
+    m_dirty = true;
+}
+
+bool ChunkSection::takeDirty() {
+    return m_dirty.exchange(false);
+}
+
+bool ChunkSection::isSkipped() const {
+    return m_skipped;
+}
+
+int ChunkSection::vertexCount() const {
+    return m_vertexCount + m_vertexCount_transparent;
+}
+
+int ChunkSection::indexCount() const {
+    return vertexCount() / 4 * 6;
+}
+
+int ChunkSection::minY() const {
+    return m_minY;
+}
+
+int ChunkSection::maxY() const {
+    return m_maxY;
+}
+
+const SectionVisibility& ChunkSection::visibility() const {
+    return m_visibility;
+}
+
+bool ChunkSection::markReached(unsigned int frame) {
+    if (m_reachedFrame == frame) {
+        return false;
+    }
+    m_reachedFrame = frame;
+    return true;
+}
+
+bool ChunkSection::reached(unsigned int frame) const {
+    return m_reachedFrame == frame;
+}
+
+void ChunkSection::setGreedyMeshing(bool enabled) {
+    s_greedyMeshing = enabled;
+}
+
+bool ChunkSection::greedyMeshing() {
+    return s_greedyMeshing;
+}
+
+int ChunkSection::block() const {
+    return m_block;
+}
+
+int ChunkSection::block_transparent() const {
+    return m_block_transparent;
+}
+
+MeshArena& ChunkSection::meshArena() {
+    return s_meshArena;
+}
+
+const QuadIndexBuffer& ChunkSection::quadIndices() {
+    return s_quadIndices;
+}
@@ -0,0 +1,239 @@
+#pragma once
+#include "drawable.h"
+#include "glm_includes.h"
+#include "palettedsection.h"
+#include "quadindexbuffer.h"
+#include "meshbuffer.h"
+#include "mesharena.h"
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+class Chunk;
+
+// One vertex of a Chunk mesh, packed into 8 bytes.
+// Everything in it is a small integer: a position inside the Chunk,
+// the direction of the face it belongs to, an atlas tile and some flags.
+// lambert.vert.glsl unpacks it.
+//   posDir   bits  0-4   x (0 - 16)
+//                  5-13  y (0 - 256)
+//                 14-18  z (0 - 16)
+//                 19-21  face Direction
+//                 22-23  FaceInset
+//                 24     sink the face by half a block
+//   texFlags bits  0-4   u, in blocks across the face (0 - 16)
+//                  5-9   v, in blocks across the face (0 - 16)
+//                 10-17  atlas tile, column + 16 * row
+//                 18-20  VertexFlags
+struct PackedVertex
+{
+    GLuint posDir;
+    GLuint texFlags;
+};
+
+// How far a face is pulled in from the edge of its block along its normal,
+// for thin or short blocks like cactus and cake: 0, 0.1, 0.2 or 0.5
+enum FaceInset : unsigned int
+{
+    INSET_NONE, INSET_TENTH, INSET_FIFTH, INSET_HALF
+};
+
+enum VertexFlags : unsigned int
+{
+    VERTEX_BETTER_TEXTURE = 1, // Sample u_textureBetter instead of u_texture
+    VERTEX_NO_NORMAL = 2,      // Liquid surface: animated waves, no normal map
+    VERTEX_ANIMATED = 4        // Sways in the wind, like fire
+};
+
+// Chunk meshes are lists of quads, four vertices each, drawn with the
+// indices in ChunkSection's shared QuadIndexBuffer
+struct ChunkVBOData
+{
+    MeshBuffer<PackedVertex> data;
+};
+
+// The sections drawn from one MeshArena page, gathered into the arrays
+// glMultiDrawElementsBaseVertex takes so the whole page is one draw call.
+// Kept between frames so that filling it doesn't allocate.
+struct ChunkDrawBatch
+{
+    std::vector<GLsizei> counts;
+    std::vector<GLint> baseVertices;
+    // Every section's indices start at the front of the shared
+    // QuadIndexBuffer, so these are all 0
+    std::vector<const void*> offsets;
+
+    void add(GLsizei count, GLint baseVertex) {
+        counts.push_back(count);
+        baseVertices.push_back(baseVertex);
+        offsets.push_back(nullptr);
+    }
+    void clear() {
+        counts.clear();
+        baseVertices.clear();
+        offsets.clear();
+    }
+    bool empty() const {
+        return counts.empty();
+    }
+};
+
+// A copy of one section's blocks plus a one-block border taken from the
+// sections around it (above, below, and in the four neighboring Chunks).
+// Meshing reads only from this, so finding a face's neighbor is a fixed
+// index offset instead of a neighbor Chunk lookup with bounds checks.
+// The twelve edge rows and eight corners are never read and stay EMPTY.
+struct SectionSnapshot
+{
+    static const int SIZE = 18;
+    // Block (x, y, z), with each coordinate in [-1, 16], lives at index(x, y, z)
+    std::array<BlockType, SIZE * SIZE * SIZE> blocks;
+
+    static int index(int x, int y, int z) {
+        return (x + 1) + SIZE * (y + 1) + SIZE * SIZE * (z + 1);
+    }
+};
+
+// Which pairs of a section's six faces can see each other through the
+// section, i.e. are joined by a path of non-opaque blocks.
+// Terrain::draw() walks from section to section only through connected
+// faces, so sections walled off by solid rock aren't drawn.
+struct SectionVisibility
+{
+    // Bit 6 * a + b is set when faces a and b are connected
+    std::uint64_t bits;
+
+    static SectionVisibility all() {
+        return SectionVisibility{(std::uint64_t(1) << 36) - 1};
+    }
+    static SectionVisibility none() {
+        return SectionVisibility{0};
+    }
+    // a and b are Directions
+    void connect(int a, int b) {
+        bits |= std::uint64_t(1) << (6 * a + b);
+        bits |= std::uint64_t(1) << (6 * b + a);
+    }
+    bool connected(int a, int b) const {
+        return (bits >> (6 * a + b)) & 1;
+    }
+};
+
+// The renderable part of one 16 x 16 x 16 slice of a Chunk.
+// Each Chunk owns sixteen of these stacked along Y, so editing a single
+// block only has to rebuild the mesh of the section that contains it
+// (and of the section across the boundary, if the block lies on one)
+// rather than the whole 16 x 256 x 16 column.
+// Vertex positions are stored in Chunk-local space. The Chunk's origin is
+// tagged onto the mesh's s_meshArena block, and added back in the shader.
+class ChunkSection : public Drawable {
+private:
+    Chunk* mp_chunk;
+    // Which 16-block slice of the Chunk this is (0 is the bottom)
+    int m_index;
+
+    // Set whenever a block that could change this section's mesh is edited.
+    // Atomic because edits on the main thread may land while a VBOWorker
+    // is meshing the Chunk.
+    std::atomic<bool> m_dirty;
+    // True when the last rebuild found nothing to draw without walking the
+    // blocks: the section is all air, or it is one uniform opaque block
+    // type surrounded by uniform opaque sections.
+    bool m_skipped;
+    // True between createVBOdata() and sendVBOdata()
+    bool m_hasPendingData;
+
+    ChunkVBOData m_VBOdata;
+    ChunkVBOData m_VBOdata_transparent;
+    // Where the uploaded meshes live in s_meshArena, or -1 if they're empty
+    int m_block;
+    int m_block_transparent;
+    // Size of the meshes built by the last createVBOdata() call, which is
+    // also what the next call sizes its buffers for
+    int m_vertexCount;
+    int m_vertexCount_transparent;
+    // Lowest and highest vertex Y of the uploaded meshes, with
+    // m_minY > m_maxY when they're empty. createVBOdata() finds them for
+    // the new meshes and sendVBOdata() makes them current.
+    int m_minY;
+    int m_maxY;
+    int m_pendingMinY;
+    int m_pendingMaxY;
+    // Face connectivity of the uploaded blocks, handed over from
+    // createVBOdata() by sendVBOdata() the same way
+    SectionVisibility m_visibility;
+    SectionVisibility m_pendingVisibility;
+    // The last Terrain frame whose visibility search reached this section
+    unsigned int m_reachedFrame;
+
+    // Whether opaque faces are merged by createGreedyOpaque()
+    static std::atomic<bool> s_greedyMeshing;
+    // The indices every section draws with
+    static QuadIndexBuffer s_quadIndices;
+    // Vertex buffers waiting to be reused by the next createVBOdata() call
+    static MeshBufferPool<PackedVertex> s_bufferPool;
+    // The GPU memory every section's vertices are uploaded to
+    static MeshArena s_meshArena;
+
+    // Hands any mesh that was built but never uploaded back to s_bufferPool
+    void releaseVBOdata();
+
+    bool isHiddenInterior() const;
+    // Flood fills the non-opaque blocks of the section from its faces
+    static SectionVisibility computeVisibility(const SectionSnapshot &snapshot);
+    // Merges the exposed faces of opaque blocks that share a BlockType and
+    // direction into as few rectangles as possible, appending them to
+    // VBOdata
+    void createGreedyOpaque(const SectionSnapshot &snapshot, MeshBuffer<PackedVertex> &VBOdata) const;
+
+public:
+    ChunkSection(OpenGLContext* context, Chunk* chunk, int index);
+    ~ChunkSection();
+
+    // Builds the section's meshes into buffers from s_bufferPool, so once
+    // the pool is warm a rebuild doesn't allocate
+    void createVBOdata() override;
+    // Uploads the data built by the last createVBOdata() call into
+    // s_meshArena, in place if it still fits, then returns the CPU-side
+    // copies to s_bufferPool. Must run on the GL thread.
+    void sendVBOdata();
+
+    // Both passes bind the shared QuadIndexBuffer
+    bool bindIdx() override;
+    bool bindIdx_transparent() override;
+    GLenum idxType() override;
+    // and the s_meshArena page holding their vertices
+    bool bindInterleave() override;
+    bool bindInterleave_transparent() override;
+    int baseVertex() override;
+    int baseVertex_transparent() override;
+
+    void markDirty();
+    // Clears the dirty flag, returning whether it was set
+    bool takeDirty();
+    bool isSkipped() const;
+    int vertexCount() const;
+    int indexCount() const;
+    // The Y extent of what is drawn, for culling
+    int minY() const;
+    int maxY() const;
+    const SectionVisibility& visibility() const;
+    // Records that frame's visibility search got here. Returns false if
+    // it already had.
+    bool markReached(unsigned int frame);
+    bool reached(unsigned int frame) const;
+
+    // Switches every subsequent mesh rebuild between one quad per face and
+    // greedy-merged opaque faces
+    static void setGreedyMeshing(bool enabled);
+    static bool greedyMeshing();
+
+    // Where the meshes are in meshArena(), or -1 if they're empty
+    int block() const;
+    int block_transparent() const;
+
+    // What Terrain needs to draw every section of an arena page at once
+    static MeshArena& meshArena();
+    static const QuadIndexBuffer& quadIndices();
+};
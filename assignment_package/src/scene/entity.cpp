@@ -86,3 +86,7 @@ void Entity::rotateOnUpGlobal(float degrees) {
     m_right = glm::vec3(glm::rotate(glm::mat4(), rad, glm::vec3(0,1,0)) * glm::vec4(m_right, 0.f));
     m_up = glm::vec3(glm::rotate(glm::mat4(), rad, glm::vec3(0,1,0)) * glm::vec4(m_up, 0.f));
 }
+
+glm::vec3 Entity::getForward() const {
+    return m_forward;
+}
@@ -58,4 +58,7 @@ public:
     virtual void rotateOnForwardGlobal(float degrees);
     virtual void rotateOnRightGlobal(float degrees);
     virtual void rotateOnUpGlobal(float degrees);
+
+    // The direction we're facing
+    glm::vec3 getForward() const;
 };
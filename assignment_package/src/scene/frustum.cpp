@@ -0,0 +1,101 @@
+#include "frustum.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+void BoxList::add(glm::vec3 min, glm::vec3 max) {
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+}
+
+void BoxList::clear() {
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+int BoxList::size() const {
+    return static_cast<int>(minX.size());
+}
+
+Frustum::Frustum(const glm::mat4 &viewProj) {
+    // glm is column-major, so row i of the matrix is viewProj[0..3][i]
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+    // Left, right, bottom, top, near, far, for OpenGL's [-1, 1] clip depth
+    m_planes = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    };
+    for (glm::vec4 &plane : m_planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersects(glm::vec3 min, glm::vec3 max) const {
+    for (const glm::vec4 &plane : m_planes) {
+        // The corner of the box furthest along the plane's normal
+        glm::vec3 corner(plane.x > 0 ? max.x : min.x,
+                         plane.y > 0 ? max.y : min.y,
+                         plane.z > 0 ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int Frustum::cull(const BoxList &boxes, std::vector<unsigned char> &visible) const {
+    int count = boxes.size();
+    visible.resize(count);
+    int visibleCount = 0;
+    int i = 0;
+
+#ifdef FRUSTUM_SSE
+    // Which side of the box to test is decided by the sign of the plane's
+    // normal, which is the same for all four boxes, so it's picked once per
+    // plane instead of per box
+    const float *cornerX[6], *cornerY[6], *cornerZ[6];
+    for (int p = 0; p < 6; p++) {
+        cornerX[p] = m_planes[p].x > 0 ? boxes.maxX.data() : boxes.minX.data();
+        cornerY[p] = m_planes[p].y > 0 ? boxes.maxY.data() : boxes.minY.data();
+        cornerZ[p] = m_planes[p].z > 0 ? boxes.maxZ.data() : boxes.minZ.data();
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 outside = zero;
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planes[p].x), _mm_loadu_ps(cornerX[p] + i)),
+                                   _mm_mul_ps(_mm_set1_ps(m_planes[p].y), _mm_loadu_ps(cornerY[p] + i))),
+                        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planes[p].z), _mm_loadu_ps(cornerZ[p] + i)),
+                                   _mm_set1_ps(m_planes[p].w)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int j = 0; j < 4; j++) {
+            visible[i + j] = !(mask & (1 << j));
+            visibleCount += visible[i + j];
+        }
+    }
+#endif
+
+    // The boxes left over from the groups of four, or all of them without SSE
+    for (; i < count; i++) {
+        visible[i] = intersects(glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]),
+                                glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+#include <vector>
+
+// Axis-aligned boxes stored as one array per coordinate, so that
+// Frustum::cull() can load the same coordinate of four boxes at once
+struct BoxList
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    void add(glm::vec3 min, glm::vec3 max);
+    void clear();
+    int size() const;
+};
+
+// The six planes bounding what a camera can see, pulled straight out of
+// its view-projection matrix (Gribb & Hartmann, "Fast Extraction of
+// Viewing Frustum Planes from the World-View-Projection Matrix").
+// A box is culled only if it lies entirely behind one of the planes, so a
+// few boxes near the frustum's corners are kept even though they're
+// outside it; that's the usual trade for six dot products per box.
+class Frustum
+{
+private:
+    // (normal, distance) with the inside on the positive side
+    std::array<glm::vec4, 6> m_planes;
+
+public:
+    explicit Frustum(const glm::mat4 &viewProj);
+
+    bool intersects(glm::vec3 min, glm::vec3 max) const;
+    // Sets visible[i] to whether box i intersects the frustum, four boxes
+    // at a time with SSE where it's available.
+    // Returns the number of visible boxes.
+    int cull(const BoxList &boxes, std::vector<unsigned char> &visible) const;
+};
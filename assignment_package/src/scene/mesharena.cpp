@@ -0,0 +1,249 @@
+#include "mesharena.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+MeshArena::MeshArena(int vertexSize, int pageVertices)
+    : m_vertexSize(vertexSize), m_pageVertices(pageVertices),
+      m_pages(), m_blocks(), m_freeHandles(), m_compactions(0)
+{}
+
+bool MeshArena::allocateInPage(int page, int size, int &offset) {
+    Page &p = m_pages[page];
+    if (p.freeVertices < size) {
+        return false;
+    }
+    // First fit keeps the low end of the page densely packed
+    for (auto it = p.freeRanges.begin(); it != p.freeRanges.end(); ++it) {
+        if (it->second >= size) {
+            offset = it->first;
+            int remaining = it->second - size;
+            p.freeRanges.erase(it);
+            if (remaining > 0) {
+                p.freeRanges[offset + size] = remaining;
+            }
+            p.freeVertices -= size;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshArena::freeInPage(int page, int offset, int size) {
+    Page &p = m_pages[page];
+    p.freeVertices += size;
+    auto next = p.freeRanges.lower_bound(offset);
+    // Merge with the range right after this block
+    if (next != p.freeRanges.end() && next->first == offset + size) {
+        size += next->second;
+        next = p.freeRanges.erase(next);
+    }
+    // and with the one right before it
+    if (next != p.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    p.freeRanges[offset] = size;
+}
+
+void MeshArena::tagOrigin(const Block &b) {
+    Page &p = m_pages[b.page];
+    for (int g = b.offset / BLOCK_GRANULARITY; g < (b.offset + b.size) / BLOCK_GRANULARITY; g++) {
+        p.origins[2 * g] = b.origin.x;
+        p.origins[2 * g + 1] = b.origin.y;
+    }
+    p.originsDirty = true;
+}
+
+void MeshArena::compact(OpenGLContext* context, int page) {
+    Page &p = m_pages[page];
+    std::vector<int> handles;
+    for (int h = 0; h < static_cast<int>(m_blocks.size()); h++) {
+        if (m_blocks[h].size != -1 && m_blocks[h].page == page) {
+            handles.push_back(h);
+        }
+    }
+    std::sort(handles.begin(), handles.end(), [this](int a, int b) {
+        return m_blocks[a].offset < m_blocks[b].offset;
+    });
+
+    // glCopyBufferSubData can't copy between overlapping ranges of one
+    // buffer, so copy everything into a fresh one
+    GLuint buffer;
+    context->glGenBuffers(1, &buffer);
+    context->glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    context->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(p.vertices) * m_vertexSize,
+                          nullptr, GL_DYNAMIC_DRAW);
+    context->glBindBuffer(GL_COPY_READ_BUFFER, p.buffer);
+    int used = 0;
+    for (int h : handles) {
+        Block &b = m_blocks[h];
+        context->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                     static_cast<GLintptr>(b.offset) * m_vertexSize,
+                                     static_cast<GLintptr>(used) * m_vertexSize,
+                                     static_cast<GLsizeiptr>(b.size) * m_vertexSize);
+        b.offset = used;
+        used += b.size;
+        tagOrigin(b);
+    }
+    context->glDeleteBuffers(1, &p.buffer);
+    p.buffer = buffer;
+    p.freeRanges.clear();
+    if (used < p.vertices) {
+        p.freeRanges[used] = p.vertices - used;
+    }
+    m_compactions++;
+}
+
+int MeshArena::allocate(OpenGLContext* context, int size) {
+    int page = -1;
+    int offset = 0;
+    for (int i = 0; i < static_cast<int>(m_pages.size()) && page == -1; i++) {
+        if (allocateInPage(i, size, offset)) {
+            page = i;
+        }
+    }
+
+    if (page == -1) {
+        // Fragmented: compact the emptiest page if it has enough room in total
+        int emptiest = -1;
+        for (int i = 0; i < static_cast<int>(m_pages.size()); i++) {
+            if (emptiest == -1 || m_pages[i].freeVertices > m_pages[emptiest].freeVertices) {
+                emptiest = i;
+            }
+        }
+        if (emptiest != -1 && m_pages[emptiest].freeVertices >= size) {
+            compact(context, emptiest);
+            if (allocateInPage(emptiest, size, offset)) {
+                page = emptiest;
+            }
+        }
+    }
+
+    if (page == -1) {
+        Page p;
+        p.vertices = std::max(m_pageVertices, size);
+        p.freeVertices = p.vertices;
+        p.freeRanges[0] = p.vertices;
+        p.origins.assign(2 * p.vertices / BLOCK_GRANULARITY, 0);
+        p.originBuffer = 0;
+        p.originTexture = 0;
+        p.originsDirty = true;
+        context->glGenBuffers(1, &p.buffer);
+        context->glBindBuffer(GL_ARRAY_BUFFER, p.buffer);
+        context->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(p.vertices) * m_vertexSize,
+                              nullptr, GL_DYNAMIC_DRAW);
+        m_pages.push_back(p);
+        page = static_cast<int>(m_pages.size()) - 1;
+        allocateInPage(page, size, offset);
+    }
+
+    int handle;
+    if (m_freeHandles.empty()) {
+        handle = static_cast<int>(m_blocks.size());
+        m_blocks.push_back(Block());
+    } else {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    }
+    m_blocks[handle] = Block{page, offset, size, glm::ivec2()};
+    return handle;
+}
+
+void MeshArena::release(int handle) {
+    if (handle == -1) {
+        return;
+    }
+    Block &b = m_blocks.at(handle);
+    if (b.size == -1) {
+        throw std::out_of_range("Mesh block " + std::to_string(handle) + " was already released!");
+    }
+    freeInPage(b.page, b.offset, b.size);
+    b.size = -1;
+    m_freeHandles.push_back(handle);
+}
+
+int MeshArena::upload(OpenGLContext* context, int handle, const void* data, int count, glm::ivec2 origin) {
+    if (count == 0) {
+        release(handle);
+        return -1;
+    }
+    int size = (count + BLOCK_GRANULARITY - 1) / BLOCK_GRANULARITY * BLOCK_GRANULARITY;
+    // Keep the old block unless it's too small, or so big that holding on
+    // to it would waste most of it
+    if (handle != -1 && (m_blocks[handle].size < size || m_blocks[handle].size > 2 * size)) {
+        release(handle);
+        handle = -1;
+    }
+    if (handle == -1) {
+        handle = allocate(context, size);
+        m_blocks[handle].origin = origin;
+        tagOrigin(m_blocks[handle]);
+    } else if (m_blocks[handle].origin != origin) {
+        m_blocks[handle].origin = origin;
+        tagOrigin(m_blocks[handle]);
+    }
+    const Block &b = m_blocks[handle];
+    context->glBindBuffer(GL_ARRAY_BUFFER, m_pages[b.page].buffer);
+    context->glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(b.offset) * m_vertexSize,
+                             static_cast<GLsizeiptr>(count) * m_vertexSize, data);
+    return handle;
+}
+
+bool MeshArena::bind(OpenGLContext* context, int handle) const {
+    if (handle == -1) {
+        return false;
+    }
+    context->glBindBuffer(GL_ARRAY_BUFFER, m_pages[m_blocks[handle].page].buffer);
+    return true;
+}
+
+void MeshArena::bindPage(OpenGLContext* context, int page) const {
+    context->glBindBuffer(GL_ARRAY_BUFFER, m_pages.at(page).buffer);
+}
+
+void MeshArena::bindOrigins(OpenGLContext* context, int page) {
+    Page &p = m_pages.at(page);
+    bool created = p.originTexture == 0;
+    if (created) {
+        context->glGenBuffers(1, &p.originBuffer);
+        context->glGenTextures(1, &p.originTexture);
+    }
+    if (p.originsDirty) {
+        context->glBindBuffer(GL_TEXTURE_BUFFER, p.originBuffer);
+        context->glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(p.origins.size() * sizeof(GLint)),
+                              p.origins.data(), GL_DYNAMIC_DRAW);
+        p.originsDirty = false;
+    }
+    context->glBindTexture(GL_TEXTURE_BUFFER, p.originTexture);
+    if (created) {
+        context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, p.originBuffer);
+    }
+}
+
+int MeshArena::page(int handle) const {
+    return m_blocks.at(handle).page;
+}
+
+int MeshArena::pageCount() const {
+    return static_cast<int>(m_pages.size());
+}
+
+int MeshArena::baseVertex(int handle) const {
+    return handle == -1 ? 0 : m_blocks[handle].offset;
+}
+
+MeshArena::Stats MeshArena::stats() const {
+    Stats s;
+    s.pages = static_cast<int>(m_pages.size());
+    for (const Page &p : m_pages) {
+        s.usedBytes += static_cast<long long>(p.vertices - p.freeVertices) * m_vertexSize;
+        s.freeBytes += static_cast<long long>(p.freeVertices) * m_vertexSize;
+    }
+    s.compactions = m_compactions;
+    return s;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "openglcontext.h"
+#include "glm_includes.h"
+#include <vector>
+#include <map>
+
+// Vertex storage for every Chunk mesh, carved out of a few large VBOs
+// ("pages") instead of giving each mesh buffers of its own.
+// A mesh owns a block of consecutive vertices in one page and refers to it
+// by a handle. It is drawn by binding the block's page and passing the
+// block's offset as the base vertex, so meshes never need a buffer name.
+// The free space in each page is a list of ranges, merged with their
+// neighbors as blocks are freed. When no range is large enough, the page
+// with the most free space is compacted on the GPU if that makes room, and
+// otherwise a new page is added.
+// Each block is also tagged with the X and Z of the Chunk it belongs to, in
+// a per-page texture buffer with one texel per BLOCK_GRANULARITY vertices,
+// so the vertex shader can place any vertex of a page from gl_VertexID
+// alone and a whole page can be drawn with one multi-draw call.
+// Everything but release() issues GL calls, so it must run on the GL thread.
+class MeshArena
+{
+public:
+    // Blocks are rounded up to this many vertices (16 quads), so a mesh that
+    // grows by a few faces on an edit usually still fits where it was.
+    // lambert.vert.glsl divides gl_VertexID by the same number.
+    static const int BLOCK_GRANULARITY = 64;
+
+    struct Stats
+    {
+        int pages = 0;
+        long long usedBytes = 0;
+        long long freeBytes = 0;
+        int compactions = 0;
+    };
+
+private:
+    struct Page
+    {
+        GLuint buffer;
+        int vertices;
+        int freeVertices;
+        // offset -> length of each free range, in vertices
+        std::map<int, int> freeRanges;
+        // The Chunk origin (x, z) of every BLOCK_GRANULARITY vertices,
+        // mirrored into originBuffer the next time the page is drawn
+        std::vector<GLint> origins;
+        GLuint originBuffer;
+        GLuint originTexture;
+        bool originsDirty;
+    };
+    struct Block
+    {
+        int page;
+        int offset;
+        // -1 for a handle that is not in use
+        int size;
+        glm::ivec2 origin;
+    };
+
+    int m_vertexSize;
+    int m_pageVertices;
+    std::vector<Page> m_pages;
+    std::vector<Block> m_blocks;
+    std::vector<int> m_freeHandles;
+    int m_compactions;
+
+    int allocate(OpenGLContext* context, int size);
+    bool allocateInPage(int page, int size, int &offset);
+    void freeInPage(int page, int offset, int size);
+    // Moves every block in the page to the front of a new buffer, leaving
+    // its free space as a single range at the end
+    void compact(OpenGLContext* context, int page);
+    void tagOrigin(const Block &b);
+
+public:
+    MeshArena(int vertexSize, int pageVertices);
+
+    // Stores count vertices from data, belonging to the Chunk at origin, in
+    // place if the block behind handle is a reasonable fit for them and in a
+    // new block otherwise.
+    // Returns the handle that now holds them, or -1 if count is 0.
+    int upload(OpenGLContext* context, int handle, const void* data, int count, glm::ivec2 origin);
+    // Frees the block behind handle. Does nothing for -1.
+    void release(int handle);
+
+    // Binds the page holding handle's block to GL_ARRAY_BUFFER
+    bool bind(OpenGLContext* context, int handle) const;
+    // Binds a page to GL_ARRAY_BUFFER
+    void bindPage(OpenGLContext* context, int page) const;
+    // Binds a page's Chunk origins to GL_TEXTURE_BUFFER on the active
+    // texture unit, uploading them first if they changed
+    void bindOrigins(OpenGLContext* context, int page);
+    // Which page handle's block is in
+    int page(int handle) const;
+    int pageCount() const;
+    // Where handle's block starts in its page, in vertices
+    int baseVertex(int handle) const;
+
+    Stats stats() const;
+};
@@ -0,0 +1,6 @@
+#include "meshbuffer.h"
+
+MeshAllocationCounter& meshAllocationCounter() {
+    thread_local MeshAllocationCounter counter;
+    return counter;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <cstddef>
+
+// Heap allocations made for mesh buffers by the calling thread, so a
+// meshing pass can report how many it needed by taking the difference
+// before and after
+struct MeshAllocationCounter
+{
+    long long allocations = 0;
+    long long bytes = 0;
+};
+
+MeshAllocationCounter& meshAllocationCounter();
+
+// std::allocator, but counted in meshAllocationCounter()
+template <typename T>
+struct MeshAllocator
+{
+    using value_type = T;
+
+    MeshAllocator() = default;
+    template <typename U>
+    MeshAllocator(const MeshAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        MeshAllocationCounter &counter = meshAllocationCounter();
+        counter.allocations++;
+        counter.bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, std::size_t n) {
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const MeshAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const MeshAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using MeshBuffer = std::vector<T, MeshAllocator<T>>;
+
+// Empty mesh buffers kept around with their capacity so the next mesh can
+// be built without allocating.
+// Buffers are filled on meshing threads and handed back once the GL thread
+// has uploaded them, so the pool is shared and locked.
+// At most MAX_FREE buffers are kept; any more are freed.
+template <typename T>
+class MeshBufferPool
+{
+private:
+    static const std::size_t MAX_FREE = 64;
+    std::mutex m_mutex;
+    std::vector<MeshBuffer<T>> m_free;
+
+public:
+    MeshBufferPool() : m_mutex(), m_free() {}
+
+    // Returns an empty buffer that can hold at least capacity elements,
+    // preferring the smallest pooled buffer that is already big enough
+    MeshBuffer<T> acquire(std::size_t capacity) {
+        MeshBuffer<T> buffer;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // The smallest buffer that fits, or failing that the largest one
+            int best = -1;
+            for (int i = 0; i < static_cast<int>(m_free.size()); i++) {
+                if (best == -1) {
+                    best = i;
+                    continue;
+                }
+                std::size_t c = m_free[i].capacity();
+                std::size_t bestC = m_free[best].capacity();
+                bool fits = c >= capacity;
+                bool bestFits = bestC >= capacity;
+                if ((fits && (!bestFits || c < bestC)) || (!fits && !bestFits && c > bestC)) {
+                    best = i;
+                }
+            }
+            if (best != -1) {
+                std::swap(m_free[best], m_free.back());
+                buffer = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        buffer.reserve(capacity);
+        return buffer;
+    }
+
+    // Takes buffer's storage, leaving it empty with no capacity
+    void release(MeshBuffer<T> &&buffer) {
+        if (buffer.capacity() == 0) {
+            return;
+        }
+        buffer.clear();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free.size() < MAX_FREE) {
+            m_free.push_back(std::move(buffer));
+        } else {
+            MeshBuffer<T>().swap(buffer);
+        }
+    }
+};
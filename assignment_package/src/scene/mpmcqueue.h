@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// A bounded queue that any number of threads may push to and pop from
+// without locking (Dmitry Vyukov's bounded MPMC queue).
+// Each cell carries a sequence number saying whether it is ready to be
+// written or read on the current lap around the ring, so a push or pop is
+// one compare-and-swap on the shared position plus a store to the cell.
+// Capacity must be a power of two. tryPush() fails instead of blocking
+// when the queue is full, and tryPop() when it is empty.
+template <typename T>
+class MPMCQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    // Keep the two positions on separate cache lines, since producers
+    // and consumers hammer them from different threads
+    alignas(64) std::unique_ptr<Cell[]> m_cells;
+    std::size_t m_mask;
+    alignas(64) std::atomic<std::size_t> m_pushPos;
+    alignas(64) std::atomic<std::size_t> m_popPos;
+
+public:
+    explicit MPMCQueue(std::size_t capacity)
+        : m_cells(new Cell[capacity]), m_mask(capacity - 1), m_pushPos(0), m_popPos(0)
+    {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+            throw std::out_of_range("MPMCQueue capacity " + std::to_string(capacity) +
+                                    " is not a power of two!");
+        }
+        for (std::size_t i = 0; i < capacity; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    bool tryPush(T &&value) {
+        std::size_t pos = m_pushPos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = m_cells[pos & m_mask];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t lap = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (lap == 0) {
+                // The cell is free on this lap; claim it
+                if (m_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                // Still holds a value from the previous lap: full
+                return false;
+            } else {
+                pos = m_pushPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &value) {
+        std::size_t pos = m_popPos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = m_cells[pos & m_mask];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t lap = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (lap == 0) {
+                if (m_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    // Free the cell for the push one lap ahead
+                    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                // Nothing has been pushed here yet: empty
+                return false;
+            } else {
+                pos = m_popPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
@@ -0,0 +1,342 @@
+#include "noisebatch.h"
+#include "biomes.h"
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NOISE_BATCH_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_BATCH_SSE
+#endif
+
+#if defined(NOISE_BATCH_AVX) || defined(NOISE_BATCH_SSE)
+
+namespace {
+
+#ifdef NOISE_BATCH_AVX
+typedef __m256i Ints;
+
+// Eight floats, each holding one point's value
+struct Lanes
+{
+    static const int WIDTH = 8;
+    __m256 v;
+
+    Lanes(__m256 v) : v(v) {}
+    Lanes(float f) : v(_mm256_set1_ps(f)) {}
+
+    static Lanes load(const float *p) { return _mm256_loadu_ps(p); }
+    void store(float *p) const { _mm256_storeu_ps(p, v); }
+    // The lanes as int32s, truncated. Values out of range become INT32_MIN.
+    Ints toInt() const { return _mm256_cvttps_epi32(v); }
+    static Lanes fromInt(Ints i) { return _mm256_cvtepi32_ps(i); }
+
+    Lanes operator+(Lanes b) const { return _mm256_add_ps(v, b.v); }
+    Lanes operator-(Lanes b) const { return _mm256_sub_ps(v, b.v); }
+    Lanes operator*(Lanes b) const { return _mm256_mul_ps(v, b.v); }
+    Lanes operator/(Lanes b) const { return _mm256_div_ps(v, b.v); }
+    // All ones in the lanes where this < b
+    Lanes operator<(Lanes b) const { return _mm256_cmp_ps(v, b.v, _CMP_LT_OQ); }
+
+    Lanes floor() const { return _mm256_floor_ps(v); }
+    Lanes abs() const { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v); }
+
+    // a in the lanes where mask is set, b elsewhere
+    static Lanes select(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+    static Lanes min(Lanes a, Lanes b) { return _mm256_min_ps(a.v, b.v); }
+    static Lanes max(Lanes a, Lanes b) { return _mm256_max_ps(a.v, b.v); }
+};
+
+Ints set1(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+Ints add(Ints a, Ints b) { return _mm256_add_epi32(a, b); }
+Ints mullo(Ints a, Ints b) { return _mm256_mullo_epi32(a, b); }
+Ints xorShiftRight(Ints a, int bits) { return _mm256_xor_si256(a, _mm256_srli_epi32(a, bits)); }
+Ints rotl17(Ints a) { return _mm256_or_si256(_mm256_slli_epi32(a, 17), _mm256_srli_epi32(a, 15)); }
+#else
+typedef __m128i Ints;
+
+// Four floats, each holding one point's value
+struct Lanes
+{
+    static const int WIDTH = 4;
+    __m128 v;
+
+    Lanes(__m128 v) : v(v) {}
+    Lanes(float f) : v(_mm_set1_ps(f)) {}
+
+    static Lanes load(const float *p) { return _mm_loadu_ps(p); }
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+    // The lanes as int32s, truncated. Values out of range become INT32_MIN.
+    Ints toInt() const { return _mm_cvttps_epi32(v); }
+    static Lanes fromInt(Ints i) { return _mm_cvtepi32_ps(i); }
+
+    Lanes operator+(Lanes b) const { return _mm_add_ps(v, b.v); }
+    Lanes operator-(Lanes b) const { return _mm_sub_ps(v, b.v); }
+    Lanes operator*(Lanes b) const { return _mm_mul_ps(v, b.v); }
+    Lanes operator/(Lanes b) const { return _mm_div_ps(v, b.v); }
+    // All ones in the lanes where this < b
+    Lanes operator<(Lanes b) const { return _mm_cmplt_ps(v, b.v); }
+
+    // SSE2 has no rounding instruction. Adding and subtracting 2^23 rounds
+    // to the nearest integer; anything larger is an integer already.
+    Lanes floor() const {
+        __m128 magic = _mm_or_ps(_mm_set1_ps(8388608.f), _mm_and_ps(v, _mm_set1_ps(-0.f)));
+        Lanes rounded = select(abs() < Lanes(8388608.f), _mm_sub_ps(_mm_add_ps(v, magic), magic), *this);
+        return rounded - select(*this < rounded, Lanes(1.f), Lanes(0.f));
+    }
+    Lanes abs() const { return _mm_andnot_ps(_mm_set1_ps(-0.f), v); }
+
+    // a in the lanes where mask is set, b elsewhere
+    static Lanes select(Lanes mask, Lanes a, Lanes b) {
+        return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+    }
+    static Lanes min(Lanes a, Lanes b) { return _mm_min_ps(a.v, b.v); }
+    static Lanes max(Lanes a, Lanes b) { return _mm_max_ps(a.v, b.v); }
+};
+
+Ints set1(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+Ints add(Ints a, Ints b) { return _mm_add_epi32(a, b); }
+// SSE2 only multiplies the even lanes, into 64 bits, so the odd ones are
+// shifted down and multiplied separately
+Ints mullo(Ints a, Ints b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+Ints xorShiftRight(Ints a, int bits) { return _mm_xor_si128(a, _mm_srli_epi32(a, bits)); }
+Ints rotl17(Ints a) { return _mm_or_si128(_mm_slli_epi32(a, 17), _mm_srli_epi32(a, 15)); }
+#endif
+
+// latticeHash() of each lane's lattice point (x, y)
+Ints latticeHash(Lanes x, Lanes y, uint32_t channel) {
+    const Ints prime3 = set1(HASH_PRIME_3);
+    const Ints prime4 = set1(HASH_PRIME_4);
+    Ints h = set1(noiseSeed() + channel * HASH_PRIME_1 + HASH_PRIME_5 + 8);
+    h = mullo(rotl17(add(h, mullo(x.toInt(), prime3))), prime4);
+    h = mullo(rotl17(add(h, mullo(y.toInt(), prime3))), prime4);
+    h = mullo(xorShiftRight(h, 15), set1(HASH_PRIME_2));
+    h = mullo(xorShiftRight(h, 13), prime3);
+    return xorShiftRight(h, 16);
+}
+
+// The top 24 bits of each hash in [0, 1)
+Lanes unitFloat(Ints h) {
+#ifdef NOISE_BATCH_AVX
+    h = _mm256_srli_epi32(h, 8);
+#else
+    h = _mm_srli_epi32(h, 8);
+#endif
+    return Lanes::fromInt(h) * (1.f / 16777216.f);
+}
+
+// hash(): the NOISE_GRADIENTS entry each lane's lattice point picks
+void gradient(Lanes x, Lanes y, Lanes &gradientX, Lanes &gradientY) {
+    const float *table = &NOISE_GRADIENTS[0].x;
+#ifdef NOISE_BATCH_AVX
+    // Entry i's x is float 2i of the table and its y float 2i + 1
+    Ints index = _mm256_slli_epi32(_mm256_srli_epi32(latticeHash(x, y, 2), 28), 1);
+    gradientX = _mm256_i32gather_ps(table, index, 4);
+    gradientY = _mm256_i32gather_ps(table + 1, index, 4);
+#else
+    alignas(16) uint32_t index[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_srli_epi32(latticeHash(x, y, 2), 28));
+    gradientX = _mm_set_ps(table[2 * index[3]], table[2 * index[2]], table[2 * index[1]], table[2 * index[0]]);
+    gradientY = _mm_set_ps(table[2 * index[3] + 1], table[2 * index[2] + 1], table[2 * index[1] + 1], table[2 * index[0] + 1]);
+#endif
+}
+
+// The quintic falloff of PerlinNoise()'s surflets
+Lanes falloff(Lanes dist) {
+    Lanes d = dist.abs();
+    Lanes d3 = d * d * d;
+    return Lanes(1.f) - d3 * 6.f * d * d + d3 * 15.f * d - d3 * 10.f;
+}
+
+Lanes surflet(Lanes px, Lanes py, Lanes gx, Lanes gy) {
+    Lanes diffX = px - gx;
+    Lanes diffY = py - gy;
+    Lanes height = diffX * unitFloat(latticeHash(gx, gy, 0)) + diffY * unitFloat(latticeHash(gx, gy, 1));
+    return height * falloff(diffX) * falloff(diffY);
+}
+
+Lanes perlinLanes(Lanes x, Lanes y) {
+    Lanes x0 = x.floor(), y0 = y.floor();
+    Lanes x1 = x0 + 1.f, y1 = y0 + 1.f;
+    return surflet(x, y, x0, y0) + surflet(x, y, x1, y0) + surflet(x, y, x1, y1) + surflet(x, y, x0, y1);
+}
+
+// One corner's contribution to SimplexNoise(), (p . p) away from it
+Lanes simplexCorner(Lanes px, Lanes py, Lanes cornerX, Lanes cornerY) {
+    Lanes h = Lanes::max(Lanes(0.5f) - (px * px + py * py), 0.f);
+    Lanes hx = 0.f, hy = 0.f;
+    gradient(cornerX, cornerY, hx, hy);
+    return h * h * h * h * (px * hx + py * hy);
+}
+
+Lanes simplexLanes(Lanes x, Lanes y) {
+    const float K1 = 0.366025404f;
+    const float K2 = 0.211324865f;
+
+    Lanes skew = (x + y) * K1;
+    Lanes ix = (x + skew).floor();
+    Lanes iy = (y + skew).floor();
+    Lanes unskew = (ix + iy) * K2;
+    Lanes ax = x - ix + unskew;
+    Lanes ay = y - iy + unskew;
+    Lanes m = Lanes::select(ax < ay, 0.f, 1.f);
+    Lanes n = Lanes(1.f) - m;
+
+    Lanes a = simplexCorner(ax, ay, ix, iy);
+    Lanes b = simplexCorner(ax - m + K2, ay - n + K2, ix + m, iy + n);
+    Lanes c = simplexCorner(ax - 1.f + 2.f * K2, ay - 1.f + 2.f * K2, ix + 1.f, iy + 1.f);
+    return a * 70.f + b * 70.f + c * 70.f;
+}
+
+Lanes bilerpLanes(Lanes x, Lanes y) {
+    Lanes x0 = x.floor(), y0 = y.floor();
+    Lanes fx = x - x0, fy = y - y0;
+    Lanes x1 = x0 + 1.f, y1 = y0 + 1.f;
+    Lanes ll = unitFloat(latticeHash(x0, y0, 0));
+    Lanes lr = unitFloat(latticeHash(x1, y0, 0));
+    Lanes ul = unitFloat(latticeHash(x0, y1, 0));
+    Lanes ur = unitFloat(latticeHash(x1, y1, 0));
+    Lanes lower = ll + fx * (lr - ll);
+    Lanes upper = ul + fx * (ur - ul);
+    return lower + fy * (upper - lower);
+}
+
+Lanes fbmLanes(Lanes x, Lanes y) {
+    Lanes sum = 0.f;
+    float freq = 1.f, amp = 1.f;
+    for (int i = 0; i < 8; i++) {
+        sum = sum + bilerpLanes(x * freq, y * freq) * amp;
+        freq *= 2.f;
+        amp *= 0.5f;
+    }
+    return sum;
+}
+
+// coord = m * coord for the column-major glm::mat2(m00, m01, m10, m11)
+void transform(Lanes &x, Lanes &y, float m00, float m01, float m10, float m11) {
+    Lanes nx = x * m00 + y * m10;
+    y = x * m01 + y * m11;
+    x = nx;
+}
+
+Lanes caveCeilLanes(Lanes x, Lanes y) {
+    x = x / 50.f;
+    y = y / 50.f;
+    Lanes h = simplexLanes(x, y) * 0.5f;
+    transform(x, y, 1.5f, 1.8f, -1.1f, 2.2f);
+    h = h + simplexLanes(x, y) * 0.25f;
+    Lanes h1 = Lanes::min(Lanes::max(h, 0.f), 1.f) * 128.f;
+
+    h = simplexLanes(x, y) * 0.5f;
+    transform(x, y, 2.9f, -1.3f, 1.4f, -1.8f);
+    h = h + simplexLanes(x, y) * 0.25f;
+    transform(x, y, 2.9f, -1.3f, 1.4f, -1.8f);
+    h = h + simplexLanes(x, y) * 0.125f;
+    Lanes h2 = Lanes::min(Lanes::max(h, 0.f), 1.f) * 32.f;
+    return Lanes::select(Lanes(0.f) < h1, h1, h2) + 1.f;
+}
+
+// Runs kernel over every lane group, padding the last one
+template<typename Kernel>
+void forEachLaneGroup(const float *x, const float *y, float *out, int n, Kernel kernel) {
+    int i = 0;
+    for (; i + Lanes::WIDTH <= n; i += Lanes::WIDTH) {
+        kernel(Lanes::load(x + i), Lanes::load(y + i)).store(out + i);
+    }
+    if (i < n) {
+        float tailX[Lanes::WIDTH] = {}, tailY[Lanes::WIDTH] = {}, tailOut[Lanes::WIDTH];
+        std::copy(x + i, x + n, tailX);
+        std::copy(y + i, y + n, tailY);
+        kernel(Lanes::load(tailX), Lanes::load(tailY)).store(tailOut);
+        std::copy(tailOut, tailOut + (n - i), out + i);
+    }
+}
+
+} // namespace
+
+const int NOISE_BATCH_WIDTH = Lanes::WIDTH;
+
+void rampBatch(const float *ends, int spans, int length, float *out) {
+    alignas(32) static const float iota[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    Lanes lane = Lanes::load(iota);
+    for (int s = 0; s < spans; s++, out += length) {
+        Lanes start = ends[s];
+        Lanes delta = ends[s + 1] - ends[s];
+        int j = 0;
+        for (; j + Lanes::WIDTH <= length; j += Lanes::WIDTH) {
+            (start + delta * ((lane + static_cast<float>(j)) / static_cast<float>(length))).store(out + j);
+        }
+        for (; j < length; j++) {
+            out[j] = ends[s] + (ends[s + 1] - ends[s]) * (static_cast<float>(j) / static_cast<float>(length));
+        }
+    }
+}
+
+void SimplexNoiseBatch(const float *x, const float *y, float *out, int n) {
+    forEachLaneGroup(x, y, out, n, simplexLanes);
+}
+
+void PerlinNoiseBatch(const float *x, const float *y, float *out, int n) {
+    forEachLaneGroup(x, y, out, n, perlinLanes);
+}
+
+void bilerpNoiseBatch(const float *x, const float *y, float *out, int n) {
+    forEachLaneGroup(x, y, out, n, bilerpLanes);
+}
+
+void fbmBatch(const float *x, const float *y, float *out, int n) {
+    forEachLaneGroup(x, y, out, n, fbmLanes);
+}
+
+void caveCeilBatch(const float *x, const float *y, float *out, int n) {
+    forEachLaneGroup(x, y, out, n, caveCeilLanes);
+}
+
+#else
+
+const int NOISE_BATCH_WIDTH = 1;
+
+// Without SIMD the batches just loop over the scalar functions
+template<typename Function>
+static void forEachPoint(const float *x, const float *y, float *out, int n, Function function) {
+    for (int i = 0; i < n; i++) {
+        out[i] = function(glm::vec2(x[i], y[i]));
+    }
+}
+
+void SimplexNoiseBatch(const float *x, const float *y, float *out, int n) {
+    forEachPoint(x, y, out, n, SimplexNoise);
+}
+
+void PerlinNoiseBatch(const float *x, const float *y, float *out, int n) {
+    forEachPoint(x, y, out, n, PerlinNoise);
+}
+
+void bilerpNoiseBatch(const float *x, const float *y, float *out, int n) {
+    forEachPoint(x, y, out, n, bilerpNoise);
+}
+
+void fbmBatch(const float *x, const float *y, float *out, int n) {
+    forEachPoint(x, y, out, n, fbm);
+}
+
+void caveCeilBatch(const float *x, const float *y, float *out, int n) {
+    forEachPoint(x, y, out, n, caveCeil);
+}
+
+void rampBatch(const float *ends, int spans, int length, float *out) {
+    for (int s = 0; s < spans; s++, out += length) {
+        for (int j = 0; j < length; j++) {
+            out[j] = ends[s] + (ends[s + 1] - ends[s]) * (static_cast<float>(j) / static_cast<float>(length));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+// Batched versions of the noise functions in biomes.h, which evaluate n
+// points at once: point i is (x[i], y[i]) and its noise goes to out[i].
+// They run NOISE_BATCH_WIDTH points per instruction using AVX2 (built with
+// CONFIG+=avx2) or SSE2, and fall back to the scalar functions elsewhere.
+//
+// Each lane does the scalar function's float arithmetic in the same order
+// and hashes lattice points with the same integer hash, so the results are
+// the same bits.
+void SimplexNoiseBatch(const float *x, const float *y, float *out, int n);
+void PerlinNoiseBatch(const float *x, const float *y, float *out, int n);
+void bilerpNoiseBatch(const float *x, const float *y, float *out, int n);
+void fbmBatch(const float *x, const float *y, float *out, int n);
+void caveCeilBatch(const float *x, const float *y, float *out, int n);
+
+// Linear interpolation between samples spaced length apart: fills
+// spans * length values, out[s * length + j] being
+// ends[s] + (ends[s + 1] - ends[s]) * (j / length)
+void rampBatch(const float *ends, int spans, int length, float *out);
+
+// How many points each instruction evaluates, 1 for the scalar fallback
+extern const int NOISE_BATCH_WIDTH;
@@ -0,0 +1,341 @@
+#include "palettedsection.h"
+#include <algorithm>
+#include <cstring>
+
+PalettedSection::PalettedSection(BlockType fill)
+    : m_palette(1, fill), m_words(), m_bits(0), m_shift(0)
+{}
+
+void PalettedSection::writeIndex(unsigned int i, unsigned int paletteIdx) {
+    unsigned int word = i >> (6 - m_shift);
+    unsigned int bit = (i & ((1u << (6 - m_shift)) - 1)) << m_shift;
+    uint64_t mask = ((uint64_t(1) << m_bits) - 1) << bit;
+    m_words[word] = (m_words[word] & ~mask) | (uint64_t(paletteIdx) << bit);
+}
+
+unsigned int PalettedSection::paletteIndexOf(BlockType t) {
+    if (m_bits == 0) {
+        // Leave uniform storage. Every block currently refers to
+        // palette entry 0, which is exactly what all-zero words encode.
+        m_bits = 1;
+        m_shift = 0;
+        m_words.assign(VOLUME / 64, 0);
+        m_palette.push_back(t);
+        return 1;
+    }
+
+    auto it = std::find(m_palette.begin(), m_palette.end(), t);
+    unsigned int paletteIdx = static_cast<unsigned int>(it - m_palette.begin());
+    if (it == m_palette.end()) {
+        if (m_palette.size() == (size_t(1) << m_bits)) {
+            grow();
+        }
+        m_palette.push_back(t);
+    }
+    return paletteIdx;
+}
+
+void PalettedSection::set(unsigned int i, BlockType t) {
+    if (m_bits == 0 && m_palette[0] == t) {
+        return;
+    }
+    writeIndex(i, paletteIndexOf(t));
+}
+
+void PalettedSection::fillSpan(unsigned int x, unsigned int z, unsigned int y0, unsigned int y1, BlockType t) {
+    if (y0 >= y1 || (m_bits == 0 && m_palette[0] == t)) {
+        return;
+    }
+    unsigned int paletteIdx = paletteIndexOf(t);
+#ifdef SECTION_LAYOUT_YXZ
+    // The span is one run of indices, so write it a word at a time:
+    // paletteIdx repeated across a word, masked to the span's bits
+    uint64_t pattern = ~uint64_t(0) / ((uint64_t(1) << m_bits) - 1) * paletteIdx;
+    unsigned int firstBit = index(x, y0, z) << m_shift;
+    unsigned int endBit = firstBit + ((y1 - y0) << m_shift);
+    for (unsigned int word = firstBit >> 6; word <= (endBit - 1) >> 6; word++) {
+        unsigned int lo = std::max(firstBit, word * 64) - word * 64;
+        unsigned int hi = std::min(endBit, word * 64 + 64) - word * 64;
+        uint64_t mask = (hi == 64 ? ~uint64_t(0) : (uint64_t(1) << hi) - 1) & ~((uint64_t(1) << lo) - 1);
+        m_words[word] = (m_words[word] & ~mask) | (pattern & mask);
+    }
+#else
+    for (unsigned int y = y0; y < y1; y++) {
+        writeIndex(index(x, y, z), paletteIdx);
+    }
+#endif
+}
+
+void PalettedSection::decodeInto(BlockType *out, int strideY, int strideZ) const {
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 16; y++) {
+            BlockType *row = out + y * strideY + z * strideZ;
+            if (m_bits == 0) {
+                std::fill(row, row + 16, m_palette[0]);
+                continue;
+            }
+            for (int x = 0; x < 16; x++) {
+                row[x] = m_palette[readIndex(index(x, y, z))];
+            }
+        }
+    }
+}
+
+void PalettedSection::fill(BlockType t) {
+    m_palette.assign(1, t);
+    m_palette.shrink_to_fit();
+    std::vector<uint64_t>().swap(m_words);
+    m_bits = 0;
+    m_shift = 0;
+}
+
+void PalettedSection::grow() {
+    std::vector<unsigned int> identity(m_palette.size());
+    for (unsigned int p = 0; p < identity.size(); p++) {
+        identity[p] = p;
+    }
+    repack(m_bits * 2, identity);
+}
+
+void PalettedSection::repack(unsigned int bits, const std::vector<unsigned int> &remap) {
+    std::vector<unsigned int> indices(VOLUME);
+    for (unsigned int i = 0; i < VOLUME; i++) {
+        indices[i] = remap[readIndex(i)];
+    }
+
+    m_bits = bits;
+    m_shift = 0;
+    while ((1u << m_shift) < m_bits) {
+        m_shift++;
+    }
+    m_words.assign(VOLUME * m_bits / 64, 0);
+    m_words.shrink_to_fit();
+    for (unsigned int i = 0; i < VOLUME; i++) {
+        writeIndex(i, indices[i]);
+    }
+}
+
+void PalettedSection::compact() {
+    if (m_bits == 0) {
+        return;
+    }
+
+    std::vector<unsigned int> counts(m_palette.size(), 0);
+    for (unsigned int i = 0; i < VOLUME; i++) {
+        counts[readIndex(i)]++;
+    }
+
+    std::vector<BlockType> palette;
+    std::vector<unsigned int> remap(m_palette.size(), 0);
+    for (unsigned int p = 0; p < m_palette.size(); p++) {
+        if (counts[p] > 0) {
+            remap[p] = static_cast<unsigned int>(palette.size());
+            palette.push_back(m_palette[p]);
+        }
+    }
+
+    if (palette.size() == 1) {
+        fill(palette[0]);
+        return;
+    }
+
+    unsigned int bits = 1;
+    while ((size_t(1) << bits) < palette.size()) {
+        bits *= 2;
+    }
+    if (bits != m_bits || palette.size() != m_palette.size()) {
+        repack(bits, remap);
+        m_palette = palette;
+        m_palette.shrink_to_fit();
+    }
+}
+
+// The first byte of each encode() form
+enum SectionEncoding : uint8_t
+{
+    ENCODING_UNIFORM, ENCODING_PACKED, ENCODING_RUNS
+};
+
+static void writeU16(std::vector<uint8_t> &out, unsigned int v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+static unsigned int readU16(const uint8_t *data) {
+    return data[0] | (static_cast<unsigned int>(data[1]) << 8);
+}
+
+void PalettedSection::encode(std::vector<uint8_t> &out) const {
+    if (m_bits == 0) {
+        out.push_back(ENCODING_UNIFORM);
+        out.push_back(static_cast<uint8_t>(m_palette[0]));
+        return;
+    }
+
+    size_t start = out.size();
+    out.push_back(ENCODING_RUNS);
+    writeU16(out, static_cast<unsigned int>(m_palette.size()));
+    for (BlockType t : m_palette) {
+        out.push_back(static_cast<uint8_t>(t));
+    }
+    size_t runCount = out.size();
+    writeU16(out, 0);
+    size_t packedBytes = VOLUME * m_bits / 8;
+    unsigned int runs = 0;
+    for (unsigned int i = 0; i < VOLUME;) {
+        unsigned int paletteIdx = readIndex(i);
+        unsigned int length = 1;
+        while (i + length < VOLUME && readIndex(i + length) == paletteIdx) {
+            length++;
+        }
+        out.push_back(static_cast<uint8_t>(paletteIdx));
+        writeU16(out, length);
+        runs++;
+        i += length;
+        // Runs are losing, so stop counting them
+        if (static_cast<size_t>(runs) * 3 > packedBytes) {
+            break;
+        }
+    }
+    if (static_cast<size_t>(runs) * 3 <= packedBytes) {
+        out[runCount] = static_cast<uint8_t>(runs);
+        out[runCount + 1] = static_cast<uint8_t>(runs >> 8);
+        return;
+    }
+
+    out.resize(start);
+    out.push_back(ENCODING_PACKED);
+    out.push_back(static_cast<uint8_t>(m_bits));
+    writeU16(out, static_cast<unsigned int>(m_palette.size()));
+    for (BlockType t : m_palette) {
+        out.push_back(static_cast<uint8_t>(t));
+    }
+    for (uint64_t word : m_words) {
+        for (int b = 0; b < 64; b += 8) {
+            out.push_back(static_cast<uint8_t>(word >> b));
+        }
+    }
+}
+
+bool PalettedSection::decode(const uint8_t *&data, const uint8_t *end) {
+    const uint8_t *p = data;
+    if (end - p < 2) {
+        return false;
+    }
+    uint8_t encoding = *p++;
+    if (encoding == ENCODING_UNIFORM) {
+        fill(static_cast<BlockType>(*p++));
+        data = p;
+        return true;
+    }
+
+    unsigned int bits = 0;
+    if (encoding == ENCODING_PACKED) {
+        bits = *p++;
+        if (bits != 1 && bits != 2 && bits != 4 && bits != 8) {
+            return false;
+        }
+    } else if (encoding != ENCODING_RUNS) {
+        return false;
+    }
+    if (end - p < 2) {
+        return false;
+    }
+    unsigned int paletteSize = readU16(p);
+    p += 2;
+    if (paletteSize < 2 || paletteSize > 256 || end - p < paletteSize) {
+        return false;
+    }
+    std::vector<BlockType> palette(reinterpret_cast<const BlockType*>(p),
+                                   reinterpret_cast<const BlockType*>(p) + paletteSize);
+    p += paletteSize;
+
+    std::vector<uint64_t> words;
+    if (encoding == ENCODING_PACKED) {
+        if (paletteSize > (1u << bits) || end - p < static_cast<ptrdiff_t>(VOLUME * bits / 8)) {
+            return false;
+        }
+        words.resize(VOLUME * bits / 64);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // The words are stored little-endian, so they can be copied as is
+        std::memcpy(words.data(), p, words.size() * sizeof(uint64_t));
+        p += words.size() * sizeof(uint64_t);
+#else
+        for (uint64_t &word : words) {
+            word = 0;
+            for (int b = 0; b < 64; b += 8) {
+                word |= static_cast<uint64_t>(*p++) << b;
+            }
+        }
+#endif
+    } else {
+        bits = 1;
+        while ((1u << bits) < paletteSize) {
+            bits *= 2;
+        }
+        if (end - p < 2) {
+            return false;
+        }
+        unsigned int runs = readU16(p);
+        p += 2;
+        if (end - p < static_cast<ptrdiff_t>(runs) * 3) {
+            return false;
+        }
+        words.assign(VOLUME * bits / 64, 0);
+        unsigned int perWordLog2 = 0;
+        while ((1u << perWordLog2) * bits < 64) {
+            perWordLog2++;
+        }
+        unsigned int i = 0;
+        for (unsigned int r = 0; r < runs; r++, p += 3) {
+            unsigned int paletteIdx = p[0];
+            unsigned int length = readU16(p + 1);
+            if (paletteIdx >= paletteSize || length > VOLUME - i) {
+                return false;
+            }
+            for (unsigned int runEnd = i + length; i < runEnd; i++) {
+                unsigned int bit = (i & ((1u << perWordLog2) - 1)) * bits;
+                words[i >> perWordLog2] |= static_cast<uint64_t>(paletteIdx) << bit;
+            }
+        }
+        if (i != VOLUME) {
+            return false;
+        }
+    }
+
+    unsigned int shift = 0;
+    while ((1u << shift) < bits) {
+        shift++;
+    }
+    if (encoding == ENCODING_PACKED && paletteSize < (1u << bits)) {
+        // Every index has to land inside the palette
+        for (unsigned int i = 0; i < VOLUME; i++) {
+            unsigned int word = i >> (6 - shift);
+            unsigned int bit = (i & ((1u << (6 - shift)) - 1)) << shift;
+            if (((words[word] >> bit) & ((uint64_t(1) << bits) - 1)) >= paletteSize) {
+                return false;
+            }
+        }
+    }
+
+    m_palette = std::move(palette);
+    m_words = std::move(words);
+    m_bits = bits;
+    m_shift = shift;
+    data = p;
+    return true;
+}
+
+unsigned int PalettedSection::bitsPerBlock() const {
+    return m_bits;
+}
+
+size_t PalettedSection::paletteSize() const {
+    return m_palette.size();
+}
+
+size_t PalettedSection::memoryUsage() const {
+    return sizeof(PalettedSection)
+            + m_palette.capacity() * sizeof(BlockType)
+            + m_words.capacity() * sizeof(uint64_t);
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// BlockType is defined in chunk.h; it is declared here with its
+// underlying type so the section can store it without including chunk.h.
+enum BlockType : unsigned char;
+
+// The order of a section's blocks. By default a column's 16 blocks are
+// consecutive (y innermost), so a vertical span of blocks shares one or two
+// packed words. Build with CONFIG+=xyz_layout for the x-innermost order.
+#if !defined(SECTION_LAYOUT_XYZ)
+#define SECTION_LAYOUT_YXZ 1
+#endif
+
+// One 16 x 16 x 16 cube of blocks.
+// Rather than storing one byte per block, a section keeps a palette of the
+// distinct BlockTypes it contains and a bit-packed array of indices into that
+// palette. The index width grows (1, 2, 4 or 8 bits) as the palette grows, and
+// a section that holds a single BlockType (all EMPTY air, all BEDROCK, ...)
+// stores no index array at all.
+class PalettedSection {
+private:
+    // The distinct BlockTypes referenced by m_words
+    std::vector<BlockType> m_palette;
+    // Palette indices, packed m_bits at a time into 64-bit words.
+    // Empty while the section is uniform.
+    std::vector<uint64_t> m_words;
+    // Bits per palette index: 0 when uniform, otherwise 1, 2, 4 or 8.
+    // Only powers of two are used so an index never straddles two words.
+    unsigned int m_bits;
+    // log2(m_bits), used to turn a block index into a word / bit offset
+    unsigned int m_shift;
+
+    unsigned int readIndex(unsigned int i) const;
+    void writeIndex(unsigned int i, unsigned int paletteIdx);
+    // The palette index of t, adding it to the palette (and leaving uniform
+    // storage) if needed. t must not be the type of a uniform section.
+    unsigned int paletteIndexOf(BlockType t);
+    // Doubles the index width and repacks every entry
+    void grow();
+    // Repacks every entry into the given (power of two) index width
+    void repack(unsigned int bits, const std::vector<unsigned int> &remap);
+
+public:
+    static const unsigned int VOLUME = 16 * 16 * 16;
+
+    // Creates a uniform section filled with the given type
+    // (BlockType(0), i.e. EMPTY, by default).
+    explicit PalettedSection(BlockType fill = BlockType(0));
+
+    // The local index of block (x, y, z): y + 16 * x + 256 * z, or
+    // x + 16 * y + 256 * z with SECTION_LAYOUT_XYZ
+    static unsigned int index(unsigned int x, unsigned int y, unsigned int z);
+
+    // i is a local index()
+    BlockType get(unsigned int i) const;
+    void set(unsigned int i, BlockType t);
+    // Sets blocks (x, y0, z) up to but not including (x, y1, z) to t
+    void fillSpan(unsigned int x, unsigned int z, unsigned int y0, unsigned int y1, BlockType t);
+
+    // Writes every block into out, placing local block (x, y, z) at
+    // out[x + y * strideY + z * strideZ]. Much cheaper than 4096 get() calls.
+    void decodeInto(BlockType *out, int strideY, int strideZ) const;
+
+    // Overwrites every block with t, returning the section to uniform storage
+    void fill(BlockType t);
+    // Drops palette entries that are no longer referenced and shrinks the
+    // index width to fit, collapsing to uniform storage when possible.
+    // Call this after large edits, e.g. once a chunk has been generated.
+    void compact();
+
+    // Appends the section to out in whichever of three forms is smallest:
+    // a single BlockType if uniform, otherwise the palette followed by
+    // either the packed indices as they are or runs of equal indices
+    void encode(std::vector<uint8_t> &out) const;
+    // Replaces the section with the one encode() wrote at data, and moves
+    // data past it. Returns false, leaving the section as it was, if the
+    // bytes up to end aren't a valid encoding.
+    bool decode(const uint8_t *&data, const uint8_t *end);
+
+    bool isUniform() const;
+    unsigned int bitsPerBlock() const;
+    size_t paletteSize() const;
+    // Heap + inline bytes used by this section
+    size_t memoryUsage() const;
+};
+
+inline unsigned int PalettedSection::index(unsigned int x, unsigned int y, unsigned int z) {
+#ifdef SECTION_LAYOUT_YXZ
+    return y + 16 * x + 256 * z;
+#else
+    return x + 16 * y + 256 * z;
+#endif
+}
+
+inline unsigned int PalettedSection::readIndex(unsigned int i) const {
+    // (6 - m_shift) is log2 of the number of indices per 64-bit word
+    unsigned int word = i >> (6 - m_shift);
+    unsigned int bit = (i & ((1u << (6 - m_shift)) - 1)) << m_shift;
+    return static_cast<unsigned int>((m_words[word] >> bit) & ((uint64_t(1) << m_bits) - 1));
+}
+
+inline BlockType PalettedSection::get(unsigned int i) const {
+    if (m_bits == 0) {
+        return m_palette[0];
+    }
+    return m_palette[readIndex(i)];
+}
+
+inline bool PalettedSection::isUniform() const {
+    return m_bits == 0;
+}
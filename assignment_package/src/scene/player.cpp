@@ -62,11 +62,12 @@ void Player::processInputs(InputBundle &inputs) {
             nothingClicked = false;
         }
         if (inputs.spacePressed) {
-            if (isOnGround(mcr_terrain, inputs) && !(getCameraBlock(mcr_terrain) == WATER) && !(getCameraBlock(mcr_terrain) == LAVA)) {
+            bool swimming = blockProperties(getCameraBlock(mcr_terrain)).has(BLOCK_LIQUID);
+            if (isOnGround(mcr_terrain, inputs) && !swimming) {
                 m_velocity.y = 30.f * m_up.y;
                 nothingClicked = false;
             }
-            else if (getCameraBlock(mcr_terrain) == WATER || getCameraBlock(mcr_terrain) == LAVA) {
+            else if (swimming) {
                 m_velocity.y += 5.f * m_up.y;
                 nothingClicked = false;
             }
@@ -94,7 +95,7 @@ void Player::computePhysics(float dT, const Terrain &terrain, InputBundle &input
     // only perform collision detection when you are not in flight mode
     if (!inputs.flight_mode) {
         if (!isOnGround(terrain, inputs)) {
-            if ((getCameraBlock(terrain) == WATER || getCameraBlock(terrain) == LAVA)) {
+            if (blockProperties(getCameraBlock(terrain)).has(BLOCK_LIQUID)) {
                 if (!inputs.spacePressed) {
                     // drop to the ground
                     gravity *= 0.3;
@@ -112,7 +113,7 @@ void Player::computePhysics(float dT, const Terrain &terrain, InputBundle &input
         }
         rayDirection = m_velocity * dT;
         detectCollision(&rayDirection, terrain);
-        if (getCameraBlock(terrain) == WATER || getCameraBlock(terrain) == LAVA || getPositionBlock(terrain) == WATER) {
+        if (blockProperties(getCameraBlock(terrain)).has(BLOCK_LIQUID) || getPositionBlock(terrain) == WATER) {
             // the player should move at 2/3 its normal speed
             rayDirection *= 0.4;
         }
@@ -166,7 +167,7 @@ bool Player::isOnGround(const Terrain &terrain, InputBundle &inputs) {
             // as long as one of the vertex is on a block that is not empty
             // player is on the ground
             BlockType currBlock = terrain.getBlockAt(vertexPos);
-            if (currBlock != EMPTY && currBlock != WATER && currBlock != LAVA) {
+            if (blockProperties(currBlock).has(BLOCK_SOLID)) {
                 inputs.isOnGround = true;
                 if (!inputs.spacePressed) {
                     m_acceleration.y = 0.f;
@@ -220,7 +221,7 @@ bool Player::gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrai
         // If currCell contains something other than EMPTY, return
         // curr_t
         BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-        if (cellType != EMPTY && cellType != WATER && cellType != LAVA) {
+        if (blockProperties(cellType).has(BLOCK_SOLID)) {
             *out_blockHit = currCell;
             *out_dist = glm::min(maxLen, curr_t);
             return true;
@@ -275,10 +276,7 @@ BlockType Player::removeBlock(Terrain *terrain) {
     if (gridMarch(rayOrigin, rayDirection, *terrain, &outDist, &outBlockHit)) {
         BlockType blockType = terrain->getBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z);
         terrain->setBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z, EMPTY);
-        uPtr<Chunk> &chunkToUpdate = terrain->getChunkAt(outBlockHit.x, outBlockHit.z);
-
-        chunkToUpdate->createVBOdata();
-        chunkToUpdate->sendVBOdata();
+        terrain->rebuildDirtySections(outBlockHit.x, outBlockHit.z);
         return blockType;
     }
     return EMPTY;
@@ -297,25 +295,19 @@ bool Player::placeBlock(Terrain *terrain, BlockType currBlockType) {
             if (ray_axis == 0) {
                 if (terrain->getBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z + glm::sign(rayDirection.z)) == EMPTY) {
                     terrain->setBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z + glm::sign(rayDirection.z), currBlockType);
-                    uPtr<Chunk> &chunkToUpdate = terrain->getChunkAt(outBlockHit.x, outBlockHit.z + glm::sign(rayDirection.z));
-                    chunkToUpdate->createVBOdata();
-                    chunkToUpdate->sendVBOdata();
+                    terrain->rebuildDirtySections(outBlockHit.x, outBlockHit.z + glm::sign(rayDirection.z));
                     return true;
                 }
             } else if (ray_axis == 1) {
                 if (terrain->getBlockAt(outBlockHit.x, outBlockHit.y + 1, outBlockHit.z) == EMPTY) {
                     terrain->setBlockAt(outBlockHit.x, outBlockHit.y + 1, outBlockHit.z, currBlockType);
-                    uPtr<Chunk> &chunkToUpdate = terrain->getChunkAt(outBlockHit.x, outBlockHit.z);
-                    chunkToUpdate->createVBOdata();
-                    chunkToUpdate->sendVBOdata();
+                    terrain->rebuildDirtySections(outBlockHit.x, outBlockHit.z);
                     return true;
                 }
             } else if (ray_axis == 2) {
                 if (terrain->getBlockAt(outBlockHit.x + glm::sign(rayDirection.x), outBlockHit.y, outBlockHit.z) == EMPTY) {
                     terrain->setBlockAt(outBlockHit.x + glm::sign(rayDirection.x), outBlockHit.y, outBlockHit.z, currBlockType);
-                    uPtr<Chunk> &chunkToUpdate = terrain->getChunkAt(outBlockHit.x, outBlockHit.z);
-                    chunkToUpdate->createVBOdata();
-                    chunkToUpdate->sendVBOdata();
+                    terrain->rebuildDirtySections(outBlockHit.x + glm::sign(rayDirection.x), outBlockHit.z);
                     return true;
                 }
             }
@@ -0,0 +1,70 @@
+#include "quadindexbuffer.h"
+#include <vector>
+#include <algorithm>
+
+// The largest number of quads whose vertices a 16-bit index can reach
+static const int MAX_SHORT_QUADS = 65536 / 4;
+
+QuadIndexBuffer::QuadIndexBuffer()
+    : m_bufIdx(), m_idxGenerated(false), m_quadCapacity(0), m_type(GL_UNSIGNED_SHORT)
+{}
+
+template <typename T>
+static std::vector<T> quadIndices(int quadCount) {
+    std::vector<T> idx;
+    idx.reserve(6 * quadCount);
+    for (int q = 0; q < quadCount; q++) {
+        T first = 4 * q;
+        idx.push_back(first);
+        idx.push_back(first + 1);
+        idx.push_back(first + 2);
+        idx.push_back(first);
+        idx.push_back(first + 2);
+        idx.push_back(first + 3);
+    }
+    return idx;
+}
+
+void QuadIndexBuffer::reserve(OpenGLContext* context, int quadCount) {
+    if (quadCount <= m_quadCapacity) {
+        return;
+    }
+    // Grow geometrically so a stream of slightly bigger meshes doesn't
+    // regenerate the buffer every time, but don't double past the 16-bit
+    // limit unless we have to
+    int capacity = std::max(quadCount, std::max(2 * m_quadCapacity, 1024));
+    if (quadCount <= MAX_SHORT_QUADS) {
+        capacity = std::min(capacity, MAX_SHORT_QUADS);
+    }
+
+    if (!m_idxGenerated) {
+        m_idxGenerated = true;
+        context->glGenBuffers(1, &m_bufIdx);
+    }
+    bind(context);
+    if (capacity <= MAX_SHORT_QUADS) {
+        std::vector<GLushort> idx = quadIndices<GLushort>(capacity);
+        context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLushort), idx.data(), GL_STATIC_DRAW);
+        m_type = GL_UNSIGNED_SHORT;
+    } else {
+        std::vector<GLuint> idx = quadIndices<GLuint>(capacity);
+        context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+        m_type = GL_UNSIGNED_INT;
+    }
+    m_quadCapacity = capacity;
+}
+
+bool QuadIndexBuffer::bind(OpenGLContext* context) const {
+    if (m_idxGenerated) {
+        context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
+    }
+    return m_idxGenerated;
+}
+
+GLenum QuadIndexBuffer::type() const {
+    return m_type;
+}
+
+int QuadIndexBuffer::quadCapacity() const {
+    return m_quadCapacity;
+}
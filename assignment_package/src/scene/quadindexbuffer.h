@@ -0,0 +1,30 @@
+#pragma once
+#include "openglcontext.h"
+
+// An element buffer holding the two triangles (0, 1, 2, 0, 2, 3) of quad
+// after quad, offset by four vertices each time.
+// Every Chunk mesh is a list of quads whose vertices come in that order,
+// so they all draw with this one buffer instead of building and uploading
+// their own indices. It is grown on demand and uses 16-bit indices for as
+// long as every mesh fits in 65536 vertices.
+class QuadIndexBuffer
+{
+private:
+    GLuint m_bufIdx;
+    bool m_idxGenerated;
+    // How many quads the indices currently cover
+    int m_quadCapacity;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum m_type;
+
+public:
+    QuadIndexBuffer();
+
+    // Makes the buffer cover at least quadCount quads, regenerating it if it
+    // is too short. Must run on the GL thread.
+    void reserve(OpenGLContext* context, int quadCount);
+    bool bind(OpenGLContext* context) const;
+
+    GLenum type() const;
+    int quadCapacity() const;
+};
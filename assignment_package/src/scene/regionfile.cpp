@@ -0,0 +1,223 @@
+#include "regionfile.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#ifdef REGION_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void putU32(uint8_t *out, uint32_t v) {
+    out[0] = static_cast<uint8_t>(v);
+    out[1] = static_cast<uint8_t>(v >> 8);
+    out[2] = static_cast<uint8_t>(v >> 16);
+    out[3] = static_cast<uint8_t>(v >> 24);
+}
+
+static uint32_t getU32(const uint8_t *in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+RegionFile::RegionFile(const std::string &path)
+    : m_mutex(), m_file(), m_entries(), m_end(HEADER_BYTES), m_fd(-1), m_map(nullptr), m_mapSize(0),
+      m_fileSize(0)
+{
+    m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!m_file.is_open()) {
+        // Doesn't exist yet: create it with an empty table
+        m_file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!m_file.is_open()) {
+            throw std::runtime_error("Can't create region file " + path);
+        }
+        std::vector<uint8_t> header(HEADER_BYTES, 0);
+        putU32(header.data(), MAGIC);
+        putU32(header.data() + 4, VERSION);
+        m_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+        m_file.flush();
+    } else {
+        std::vector<uint8_t> header(HEADER_BYTES);
+        m_file.read(reinterpret_cast<char*>(header.data()), header.size());
+        if (!m_file || getU32(header.data()) != MAGIC || getU32(header.data() + 4) != VERSION) {
+            throw std::runtime_error(path + " is not a region file");
+        }
+        for (int i = 0; i < SIZE * SIZE; i++) {
+            const uint8_t *entry = header.data() + 8 + 12 * i;
+            m_entries[i] = Entry{getU32(entry), getU32(entry + 4), getU32(entry + 8)};
+            if (m_entries[i].length > 0) {
+                m_end = std::max(m_end, m_entries[i].offset + m_entries[i].length);
+            }
+        }
+    }
+
+#ifdef REGION_MMAP
+    // Without a mapping, reads fall back to m_file
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if (m_fd >= 0) {
+        growMapping();
+    }
+#endif
+}
+
+RegionFile::~RegionFile() {
+#ifdef REGION_MMAP
+    if (m_map != nullptr) {
+        munmap(const_cast<uint8_t*>(m_map), m_mapSize);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+#endif
+}
+
+void RegionFile::growMapping() {
+#ifdef REGION_MMAP
+    if (m_fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(m_fd, &info) != 0) {
+        // Without the size there's no telling which entries are safe to
+        // read through the mapping, so reads fall back to m_file
+        if (m_map != nullptr) {
+            munmap(const_cast<uint8_t*>(m_map), m_mapSize);
+            m_map = nullptr;
+        }
+        m_mapSize = 0;
+        return;
+    }
+    m_fileSize = static_cast<size_t>(info.st_size);
+    if (m_end <= m_mapSize) {
+        return;
+    }
+    if (m_map != nullptr) {
+        munmap(const_cast<uint8_t*>(m_map), m_mapSize);
+        m_map = nullptr;
+    }
+    size_t size = (m_end + MAP_STEP - 1) / MAP_STEP * MAP_STEP;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        m_mapSize = 0;
+        return;
+    }
+    m_map = static_cast<const uint8_t*>(map);
+    m_mapSize = size;
+#endif
+}
+
+int RegionFile::entryIndex(int localX, int localZ) {
+    return (localX & MASK) + SIZE * (localZ & MASK);
+}
+
+void RegionFile::writeEntry(int i) {
+    uint8_t entry[12];
+    putU32(entry, m_entries[i].offset);
+    putU32(entry + 4, m_entries[i].length);
+    putU32(entry + 8, m_entries[i].crc);
+    m_file.seekp(8 + 12 * i);
+    m_file.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+}
+
+bool RegionFile::contains(int localX, int localZ) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_entries[entryIndex(localX, localZ)].length > 0;
+}
+
+bool RegionFile::read(int localX, int localZ, bool mapped, const Decoder &decode) {
+    if (mapped) {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (m_map != nullptr) {
+            const Entry &entry = m_entries[entryIndex(localX, localZ)];
+            if (entry.length == 0 || static_cast<size_t>(entry.offset) + entry.length > m_fileSize) {
+                return false;
+            }
+            const uint8_t *payload = m_map + entry.offset;
+            return crc32(payload, entry.length) == entry.crc && decode(payload, entry.length);
+        }
+    }
+
+    std::vector<uint8_t> payload;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        const Entry &entry = m_entries[entryIndex(localX, localZ)];
+        if (entry.length == 0) {
+            return false;
+        }
+        payload.resize(entry.length);
+        m_file.clear();
+        m_file.seekg(entry.offset);
+        m_file.read(reinterpret_cast<char*>(payload.data()), entry.length);
+        if (!m_file || crc32(payload.data(), payload.size()) != entry.crc) {
+            return false;
+        }
+    }
+    return decode(payload.data(), payload.size());
+}
+
+void RegionFile::write(int localX, int localZ, const std::vector<uint8_t> &payload) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    int i = entryIndex(localX, localZ);
+    Entry entry = m_entries[i];
+    if (payload.size() > entry.length) {
+        entry.offset = m_end;
+        m_end += static_cast<uint32_t>(payload.size());
+    }
+    entry.length = static_cast<uint32_t>(payload.size());
+    entry.crc = crc32(payload.data(), payload.size());
+
+    // Payload before table entry, so that a crash in between leaves at
+    // worst a checksum mismatch rather than a table pointing at garbage
+    m_file.clear();
+    m_file.seekp(entry.offset);
+    m_file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    m_file.flush();
+    m_entries[i] = entry;
+    writeEntry(i);
+    m_file.flush();
+    // The flushes went through the page cache the mapping reads from, so
+    // only a payload past the end of the mapping needs a remap
+    growMapping();
+}
+
+void RegionFile::prefetch(int localX, int localZ) const {
+#ifdef REGION_MMAP
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    const Entry &entry = m_entries[entryIndex(localX, localZ)];
+    if (m_map == nullptr || entry.length == 0) {
+        return;
+    }
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t first = entry.offset / page * page;
+    madvise(const_cast<uint8_t*>(m_map) + first, entry.offset + entry.length - first, MADV_WILLNEED);
+#endif
+}
+
+bool RegionFile::isMapped() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_map != nullptr;
+}
+
+uint32_t RegionFile::dataBytes() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_end - HEADER_BYTES;
+}
+
+uint32_t RegionFile::crc32(const uint8_t *data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// Reading region files through mmap needs POSIX. Elsewhere every read goes
+// through the buffered fallback.
+#if defined(__unix__) || defined(__APPLE__)
+#define REGION_MMAP 1
+#endif
+
+// One file holding the saved blocks of a 32 x 32 square of Chunks.
+// It starts with a table giving each Chunk's offset, length and CRC-32
+// within the file, followed by the Chunks' Chunk::encodeBlocks() payloads.
+// A payload that grows is moved to the end of the file; the space it
+// leaves behind is not reused.
+// Reads can be served straight out of a read-only mapping of the file,
+// so any number of threads can decode from it at once; only write(),
+// and buffered reads, which share the file position, take turns.
+class RegionFile
+{
+public:
+    static const int SIZE_LOG2 = 5;
+    static const int SIZE = 1 << SIZE_LOG2;
+    static const int MASK = SIZE - 1;
+
+    // Called with a Chunk's payload, returning whether it decoded
+    using Decoder = std::function<bool(const uint8_t*, size_t)>;
+
+private:
+    struct Entry
+    {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t crc;
+    };
+
+    static const uint32_t MAGIC = 0x524d4d4d; // "MMMR"
+    // Payloads store sections in PalettedSection's block order, so files
+    // written with one SECTION_LAYOUT are rejected by the other
+#ifdef SECTION_LAYOUT_XYZ
+    static const uint32_t VERSION = 1;
+#else
+    static const uint32_t VERSION = 2;
+#endif
+    static const int HEADER_BYTES = 8 + SIZE * SIZE * 12;
+    // The mapping is grown in steps of this much, so appending a payload
+    // doesn't remap the file every time
+    static const size_t MAP_STEP = size_t(4) << 20;
+
+    // Shared by mapped reads, exclusive for writes and buffered reads
+    mutable std::shared_mutex m_mutex;
+    std::fstream m_file;
+    std::array<Entry, SIZE * SIZE> m_entries;
+    // Where the next payload that doesn't fit its old slot goes
+    uint32_t m_end;
+
+    // The file mapped read-only, or nullptr if mapping isn't available.
+    // m_mapSize may run past the end of the file; only bytes that
+    // m_entries point to are ever touched.
+    int m_fd;
+    const uint8_t *m_map;
+    size_t m_mapSize;
+    // The file's size as of the last growMapping(). A truncated file can
+    // have entries pointing past its end, and reading those through the
+    // mapping raises SIGBUS rather than failing like a buffered read.
+    size_t m_fileSize;
+
+    static int entryIndex(int localX, int localZ);
+    void writeEntry(int i);
+    // Updates m_fileSize, and maps the file again if m_end has outgrown
+    // the mapping. Call with m_mutex held exclusively.
+    void growMapping();
+
+public:
+    // Opens the region file at path, creating it if it doesn't exist.
+    // Throws std::runtime_error if it can't be opened or isn't a region file.
+    explicit RegionFile(const std::string &path);
+    ~RegionFile();
+    RegionFile(const RegionFile&) = delete;
+    RegionFile& operator=(const RegionFile&) = delete;
+
+    // Chunk coordinates within the region, in [0, SIZE)
+    bool contains(int localX, int localZ) const;
+    // Checks the payload saved for that Chunk against its checksum and
+    // hands it to decode. With mapped set and a mapping available, decode
+    // reads straight from the mapping; otherwise the payload is first read
+    // into a buffer. Returns false if there is no payload, it's corrupt,
+    // or decode rejects it.
+    bool read(int localX, int localZ, bool mapped, const Decoder &decode);
+    void write(int localX, int localZ, const std::vector<uint8_t> &payload);
+    // Asks the OS to start paging in that Chunk's payload, if it's mapped
+    void prefetch(int localX, int localZ) const;
+    bool isMapped() const;
+    // Bytes of payload data in the file, including space lost to moves
+    uint32_t dataBytes() const;
+
+    // The CRC-32 (IEEE 802.3) of size bytes at data
+    static uint32_t crc32(const uint8_t *data, size_t size);
+};
@@ -1,19 +1,41 @@
 #include "terrain.h"
 #include "cube.h"
 #include "biomes.h"
+#include "noisebatch.h"
+#include "cavedensity.h"
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(),
+    : m_chunks(), m_grid(),
       m_generatedTerrain(),
 //      m_geomCube(context),
-      mp_context(context)
-{}
+      mp_context(context),
+      m_renderList(), m_opaqueBatches(), m_transparentBatches(),
+      m_chunkBoxes(), m_sectionBoxes(), m_candidateChunks(), m_candidateSections(), m_visible(),
+      m_visibilityQueue(), m_occlusionCulling(true), m_frame(0), m_batchedDrawing(true), m_drawStats(),
+      BlockTypeBuffer(4096), DecorationBuffer(4096), VBOdataBuffer(4096), m_climate(), m_climateCaching(true), m_densityCaves(true), m_storage(), m_lastPlayerZone(0), m_scheduler(), m_workers(mkU<WorkerPool>()),
+      m_inFlight(), m_loadStats(),
+      m_pendingUploads(), m_uploadBudgetMs(DEFAULT_UPLOAD_BUDGET_MS), m_uploadBudgetBytes(DEFAULT_UPLOAD_BUDGET_BYTES),
+      m_uploadHistory(), m_uploadFrame(0),
+      m_leftZones(), m_leftZoneIndex(), m_memoryBudget(DEFAULT_MEMORY_BUDGET)
+{
+    m_scheduler = mkU<ChunkScheduler>(*m_workers, [this](Chunk *chunk, ChunkScheduler::JobType type) {
+        if (type == ChunkScheduler::GENERATE) {
+            BlockTypeWorker(chunk);
+        } else if (type == ChunkScheduler::DECORATE) {
+            DecorationWorker(chunk);
+        } else {
+            VBOWorker(chunk);
+        }
+    });
+}
 
 Terrain::~Terrain() {
 //    m_geomCube.destroyVBOdata();
+    end();
 }
 
 // Combine two 32-bit ints into one 64-bit int
@@ -52,17 +74,15 @@ glm::ivec2 toCoords(int64_t k) {
 // the coordinates at x, y, z have a corresponding Chunk
 BlockType Terrain::getBlockAt(int x, int y, int z) const
 {
-    if(hasChunkAt(x, z)) {
+    if(const Chunk *c = chunkAt(x, z)) {
         // Just disallow action below or above min/max height,
         // but don't crash the game over it.
         if(y < 0 || y >= 256) {
             return EMPTY;
         }
-        const uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        return c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
+        return c->getBlockAt(static_cast<unsigned int>(x & 15),
                              static_cast<unsigned int>(y),
-                             static_cast<unsigned int>(z - chunkOrigin.y));
+                             static_cast<unsigned int>(z & 15));
     }
     else {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
@@ -76,16 +96,19 @@ BlockType Terrain::getBlockAt(glm::vec3 p) const {
 }
 
 bool Terrain::hasChunkAt(int x, int z) const {
-    // Map x and z to their nearest Chunk corner
-    // By flooring x and z, then multiplying by 16,
-    // we clamp (x, z) to its nearest Chunk-space corner,
-    // then scale back to a world-space location.
-    // Note that floor() lets us handle negative numbers
-    // correctly, as floor(-1 / 16.f) gives us -1, as
-    // opposed to (int)(-1 / 16.f) giving us 0 (incorrect!).
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor)) != m_chunks.end();
+    return chunkAt(x, z) != nullptr;
+}
+
+Chunk* Terrain::chunkAt(int x, int z) const {
+    // Shifting right floors, even for negative numbers, so this is the
+    // Chunk-space corner that the division by 16.f used to find
+    int cx = x >> 4;
+    int cz = z >> 4;
+    if (m_grid.contains(cx, cz)) {
+        return m_grid.find(cx, cz);
+    }
+    auto it = m_chunks.find(toKey(16 * cx, 16 * cz));
+    return it == m_chunks.end() ? nullptr : it->second.get();
 }
 
 bool Terrain::hasZoneAt(int x, int z) const {
@@ -110,13 +133,32 @@ const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
 void Terrain::setBlockAt(int x, int y, int z, enum BlockType t)
 {
 
-    if(hasChunkAt(x, z)) {
-        uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        c->setBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
-                      static_cast<unsigned int>(y),
-                      static_cast<unsigned int>(z - chunkOrigin.y),
-                      t);
+    if(Chunk *c = chunkAt(x, z)) {
+        int localX = x & 15;
+        int localZ = z & 15;
+        {
+            // A neighbor's VBOWorker may be reading this Chunk's edge
+            std::unique_lock<std::shared_mutex> lock(c->blocksMutex());
+            if (c->getBlockAt(localX, y, localZ) == t) {
+                return;
+            }
+            c->setBlockAt(static_cast<unsigned int>(localX),
+                          static_cast<unsigned int>(y),
+                          static_cast<unsigned int>(localZ),
+                          t);
+        }
+        // A block on the Chunk's edge is also visible to the
+        // neighboring Chunk's mesh
+        if (localX == 0 && c->m_neighbors[XNEG] != nullptr) {
+            c->m_neighbors[XNEG]->markDirty(y);
+        } else if (localX == 15 && c->m_neighbors[XPOS] != nullptr) {
+            c->m_neighbors[XPOS]->markDirty(y);
+        }
+        if (localZ == 0 && c->m_neighbors[ZNEG] != nullptr) {
+            c->m_neighbors[ZNEG]->markDirty(y);
+        } else if (localZ == 15 && c->m_neighbors[ZPOS] != nullptr) {
+            c->m_neighbors[ZPOS]->markDirty(y);
+        }
     }
     else {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
@@ -133,75 +175,225 @@ Chunk* Terrain::instantiateChunkAt(int x, int z) {
 
     Chunk *chunk = newChunkBuffer[toKey(x, z)].get();
 
-    if (hasChunkAt(x, z + 16)) {
-        auto &chunkNorth = getChunkAt(x, z + 16);
-        chunk->linkNeighbor(chunkNorth, ZPOS);
-    }
-    if (hasChunkAt(x, z - 16)) {
-        auto &chunkSouth = getChunkAt(x, z - 16);
-        chunk->linkNeighbor(chunkSouth, ZNEG);
-    }
-    if (hasChunkAt(x + 16, z)) {
-        auto &chunkEast = getChunkAt(x + 16, z);
-        chunk->linkNeighbor(chunkEast, XPOS);
-    }
-    if (hasChunkAt(x - 16, z)) {
-        auto &chunkWest = getChunkAt(x - 16, z);
-        chunk->linkNeighbor(chunkWest, XNEG);
+    // Neighbors may have been uploaded already, or still be on their way,
+    // including those created alongside this one
+    static const std::array<std::pair<Direction, glm::ivec2>, 4> neighbors {
+        std::make_pair(ZPOS, glm::ivec2(0, 16)), std::make_pair(ZNEG, glm::ivec2(0, -16)),
+        std::make_pair(XPOS, glm::ivec2(16, 0)), std::make_pair(XNEG, glm::ivec2(-16, 0))
+    };
+    for (const auto &[dir, offset] : neighbors) {
+        Chunk *neighbor = chunkAt(x + offset.x, z + offset.y);
+        if (neighbor == nullptr) {
+            auto inFlight = m_inFlight.find(toKey(x + offset.x, z + offset.y));
+            if (inFlight != m_inFlight.end()) {
+                neighbor = inFlight->second.chunk;
+            }
+        }
+        chunk->linkNeighbor(neighbor, dir);
     }
 
-    if (hasNewChunkAt(x, z + 16)) {
-        auto &chunkNorth = getNewChunkAt(x, z + 16);
-        chunk->linkNeighbor(chunkNorth, ZPOS);
+    return chunk;
+
+}
+
+
+
+void Terrain::rebuildDirtySections(int x, int z) {
+    static const std::array<glm::ivec2, 5> offsets {
+        glm::ivec2(0, 0), glm::ivec2(16, 0), glm::ivec2(-16, 0), glm::ivec2(0, 16), glm::ivec2(0, -16)
+    };
+    for (const glm::ivec2 &offset : offsets) {
+        if (hasChunkAt(x + offset.x, z + offset.y)) {
+            uPtr<Chunk> &chunk = getChunkAt(x + offset.x, z + offset.y);
+            // Only the sections marked dirty are remeshed
+            chunk->createVBOdata();
+            chunk->sendVBOdata();
+        }
     }
-    if (hasNewChunkAt(x, z - 16)) {
-        auto &chunkSouth = getNewChunkAt(x, z - 16);
-        chunk->linkNeighbor(chunkSouth, ZNEG);
+}
+
+// Draws every ChunkSection that has geometry and isn't outside the
+// frustum, gathered by the arena page its mesh lives in. Each Chunk's
+// position comes from the page's origin table, so there is no model
+// matrix to set per Chunk.
+void Terrain::draw(int minX, int maxX, int minZ, int maxZ, const Frustum &frustum,
+                   glm::vec3 cameraPos, ShaderProgram *shaderProgram) {
+    auto start = std::chrono::steady_clock::now();
+    m_drawStats = DrawStats();
+    m_frame++;
+    bool occlusion = m_occlusionCulling &&
+            findReachableSections(minX, maxX, minZ, maxZ, frustum, cameraPos);
+
+    const MeshArena &arena = ChunkSection::meshArena();
+    m_opaqueBatches.resize(arena.pageCount());
+    m_transparentBatches.resize(arena.pageCount());
+    for (int page = 0; page < arena.pageCount(); page++) {
+        m_opaqueBatches[page].clear();
+        m_transparentBatches[page].clear();
     }
-    if (hasNewChunkAt(x + 16, z)) {
-        auto &chunkEast = getNewChunkAt(x + 16, z);
-        chunk->linkNeighbor(chunkEast, XPOS);
+
+    // Test whole Chunks first, bounded by the Y extent of their meshes
+    // rather than the full 256 blocks
+    m_chunkBoxes.clear();
+    m_candidateChunks.clear();
+    for (Chunk *chunk : m_renderList) {
+        if (chunk->m_pos.x + 16 <= minX || chunk->m_pos.x >= maxX ||
+            chunk->m_pos.y + 16 <= minZ || chunk->m_pos.y >= maxZ) {
+            continue;
+        }
+        int minY = 256, maxY = 0;
+        for (int i = 0; i < 16; i++) {
+            minY = std::min(minY, chunk->sectionMesh(i)->minY());
+            maxY = std::max(maxY, chunk->sectionMesh(i)->maxY());
+        }
+        if (minY > maxY) {
+            continue;
+        }
+        m_candidateChunks.push_back(chunk);
+        // Liquid surfaces ripple up to a block below their vertices
+        m_chunkBoxes.add(glm::vec3(chunk->m_pos.x, minY - 1, chunk->m_pos.y),
+                         glm::vec3(chunk->m_pos.x + 16, maxY + 1, chunk->m_pos.y + 16));
     }
-    if (hasNewChunkAt(x - 16, z)) {
-        auto &chunkWest = getNewChunkAt(x - 16, z);
-        chunk->linkNeighbor(chunkWest, XNEG);
+    m_drawStats.chunksDrawn = frustum.cull(m_chunkBoxes, m_visible);
+    m_drawStats.chunksCulled = m_chunkBoxes.size() - m_drawStats.chunksDrawn;
+
+    // Then the sections of the Chunks that passed
+    m_sectionBoxes.clear();
+    m_candidateSections.clear();
+    for (int c = 0; c < static_cast<int>(m_candidateChunks.size()); c++) {
+        if (!m_visible[c]) {
+            continue;
+        }
+        Chunk *chunk = m_candidateChunks[c];
+        for (int i = 0; i < 16; i++) {
+            ChunkSection *section = chunk->sectionMesh(i);
+            if (section->minY() > section->maxY()) {
+                continue;
+            }
+            if (occlusion && !section->reached(m_frame)) {
+                m_drawStats.sectionsOccluded++;
+                continue;
+            }
+            m_candidateSections.push_back(section);
+            m_sectionBoxes.add(glm::vec3(chunk->m_pos.x, section->minY() - 1, chunk->m_pos.y),
+                               glm::vec3(chunk->m_pos.x + 16, section->maxY() + 1, chunk->m_pos.y + 16));
+        }
     }
+    m_drawStats.sections = frustum.cull(m_sectionBoxes, m_visible);
+    m_drawStats.sectionsCulled = m_sectionBoxes.size() - m_drawStats.sections;
 
+    for (int i = 0; i < static_cast<int>(m_candidateSections.size()); i++) {
+        if (!m_visible[i]) {
+            continue;
+        }
+        ChunkSection *section = m_candidateSections[i];
+        if (section->elemCount() > 0) {
+            m_opaqueBatches[arena.page(section->block())].add(section->elemCount(),
+                                                              arena.baseVertex(section->block()));
+        }
+        if (section->elemCount_transparent() > 0) {
+            m_transparentBatches[arena.page(section->block_transparent())].add(
+                        section->elemCount_transparent(), arena.baseVertex(section->block_transparent()));
+        }
+    }
 
-    return chunk;
+    shaderProgram->setModelMatrix(glm::mat4(1.f));
+    drawBatches(m_opaqueBatches, false, shaderProgram);
+    drawBatches(m_transparentBatches, true, shaderProgram);
 
+    m_drawStats.cpuMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
+bool Terrain::findReachableSections(int minX, int maxX, int minZ, int maxZ,
+                                    const Frustum &frustum, glm::vec3 cameraPos) {
+    int cameraX = static_cast<int>(glm::floor(cameraPos.x));
+    int cameraZ = static_cast<int>(glm::floor(cameraPos.z));
+    int cameraSection = static_cast<int>(glm::floor(cameraPos.y / 16.f));
+    Chunk *cameraChunk = chunkAt(cameraX, cameraZ);
+    if (cameraSection < 0 || cameraSection > 15 || cameraChunk == nullptr) {
+        return false;
+    }
 
-
-// TODO: When you make Chunk inherit from Drawable, change this code so
-// it draws each Chunk with the given ShaderProgram, remembering to set the
-// model matrix to the proper X and Z translation!
-void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram) {
-
-//    chunksWithBlockDataMutex.lock();
-
-    for(int x = minX; x < maxX; x += 16) {
-        for(int z = minZ; z < maxZ; z += 16) {
-            if (hasChunkAt(x, z)) {
-                const uPtr<Chunk> &chunk = getChunkAt(x, z);
-                shaderProgram->setModelMatrix(glm::translate(glm::mat4(1.f), glm::vec3(x, 0.f, z)));
-                shaderProgram->drawInterleave(*chunk, 0);
+    // Breadth first, with m_visibilityQueue reused as the queue
+    m_visibilityQueue.clear();
+    cameraChunk->sectionMesh(cameraSection)->markReached(m_frame);
+    m_visibilityQueue.push_back(VisibilityStep{cameraChunk, cameraSection, -1, 0});
+    for (size_t head = 0; head < m_visibilityQueue.size(); head++) {
+        VisibilityStep step = m_visibilityQueue[head];
+        const SectionVisibility &visibility = step.chunk->sectionMesh(step.section)->visibility();
+        for (int d = 0; d < 6; d++) {
+            Direction dir = Direction(d);
+            // Opposite Directions differ only in their lowest bit
+            int back = d ^ 1;
+            // Never turn back on the path so far, which keeps the search
+            // heading away from the camera
+            if (step.directions & (1 << back)) {
+                continue;
+            }
+            if (step.from != -1 && !visibility.connected(step.from, d)) {
+                continue;
+            }
+            Chunk *chunk = step.chunk;
+            int section = step.section;
+            if (dir == YPOS || dir == YNEG) {
+                section += dir == YPOS ? 1 : -1;
+                if (section < 0 || section > 15) {
+                    continue;
+                }
+            } else {
+                chunk = chunk->m_neighbors[dir];
+                if (chunk == nullptr || chunk->m_pos.x + 16 <= minX || chunk->m_pos.x >= maxX ||
+                    chunk->m_pos.y + 16 <= minZ || chunk->m_pos.y >= maxZ) {
+                    continue;
+                }
+            }
+            glm::vec3 corner(chunk->m_pos.x, 16 * section, chunk->m_pos.y);
+            if (!frustum.intersects(corner, corner + glm::vec3(16.f))) {
+                continue;
+            }
+            if (chunk->sectionMesh(section)->markReached(m_frame)) {
+                m_visibilityQueue.push_back(VisibilityStep{chunk, section, back, step.directions | (1 << d)});
             }
         }
     }
-    for(int x = minX; x < maxX; x += 16) {
-        for(int z = minZ; z < maxZ; z += 16) {
-            if (hasChunkAt(x, z)) {
-                const uPtr<Chunk> &chunk = getChunkAt(x, z);
-                shaderProgram->setModelMatrix(glm::translate(glm::mat4(1.f), glm::vec3(x, 0.f, z)));
-                shaderProgram->drawInterleave_transparent(*chunk, 0);
+    return true;
+}
+
+void Terrain::drawBatches(std::vector<ChunkDrawBatch> &batches, bool transparent, ShaderProgram *shaderProgram) {
+    for (int page = 0; page < static_cast<int>(batches.size()); page++) {
+        const ChunkDrawBatch &batch = batches[page];
+        if (batch.empty()) {
+            continue;
+        }
+        if (m_batchedDrawing) {
+            m_drawStats.drawCalls += shaderProgram->drawChunkBatch(page, batch, transparent,
+                                                                   0, static_cast<int>(batch.counts.size()));
+        } else {
+            for (int i = 0; i < static_cast<int>(batch.counts.size()); i++) {
+                m_drawStats.drawCalls += shaderProgram->drawChunkBatch(page, batch, transparent, i, 1);
             }
         }
     }
+}
 
-//    chunksWithBlockDataMutex.unlock();
+const DrawStats& Terrain::drawStats() const {
+    return m_drawStats;
+}
+
+void Terrain::setBatchedDrawing(bool batched) {
+    m_batchedDrawing = batched;
+}
+
+bool Terrain::batchedDrawing() const {
+    return m_batchedDrawing;
+}
 
+void Terrain::setOcclusionCulling(bool enabled) {
+    m_occlusionCulling = enabled;
+}
+
+bool Terrain::occlusionCulling() const {
+    return m_occlusionCulling;
 }
 
 void Terrain::CreateTestScene()
@@ -213,184 +405,251 @@ void Terrain::CreateTestScene()
 
 
 void Terrain::fillColumn(Chunk *chunk, int x, int z) {
-
     int map_x = chunk->m_pos[0] + x;
     int map_z = chunk->m_pos[1] + z;
 
+    ClimateColumn climate(m_climateCaching ? m_climate.get(map_x, map_z)->sample(map_x, map_z)
+                                           : ClimateSample::at(map_x, map_z));
+    if (m_densityCaves) {
+        std::array<float, CaveDensity::HEIGHT> density;
+        CaveDensity::columnAt(map_x, map_z, density.data());
+        fillColumn(chunk, x, z, climate, 0, density.data());
+    } else {
+        fillColumn(chunk, x, z, climate, static_cast<int>(caveCeil(glm::vec2(map_x, map_z))), nullptr);
+    }
+}
 
-    //moisture return (-1, 1)
-
-
-    int caveCeilHeight = caveCeil(glm::vec2(map_x, map_z));
-    int caveFloorHeight = caveCeil(glm::vec2(map_x, map_z));
+// The climate of every column of chunk, column (x, z) being entry x + 16 * z
+static std::vector<ClimateColumn> chunkClimates(ZoneClimateCache &cache, bool cached, const Chunk *chunk) {
+    // A Chunk never straddles two zones
+    std::shared_ptr<const ZoneClimate> zone;
+    if (cached) {
+        zone = cache.get(chunk->m_pos[0], chunk->m_pos[1]);
+    }
+    std::vector<ClimateColumn> climates;
+    climates.reserve(256);
+    for (int i = 0; i < 256; i++) {
+        int map_x = chunk->m_pos[0] + (i & 15);
+        int map_z = chunk->m_pos[1] + (i >> 4);
+        climates.emplace_back(zone != nullptr ? zone->sample(map_x, map_z) : ClimateSample::at(map_x, map_z));
+    }
+    return climates;
+}
 
-//     Cave
-    for (int k = 0; k < 64; k++) { // start from the ground
-        chunk->setBlockAt(x, k, z, BEDROCK);
+void Terrain::fillChunk(Chunk *chunk) {
+    // Column (x, z) is entry x + 16 * z
+    std::array<float, 256> caveCeilHeights = {};
+    uPtr<CaveDensity> caves;
+    if (m_densityCaves) {
+        caves = mkU<CaveDensity>(chunk->m_pos);
+    } else {
+        std::array<float, 256> columnX, columnZ;
+        for (int i = 0; i < 256; i++) {
+            columnX[i] = chunk->m_pos[0] + (i & 15);
+            columnZ[i] = chunk->m_pos[1] + (i >> 4);
+        }
+        caveCeilBatch(columnX.data(), columnZ.data(), caveCeilHeights.data(), 256);
     }
 
-    for (int k = 64; k < 64 + caveFloorHeight; k++) {
-        chunk->setBlockAt(x, k, z, STONE);
+    std::vector<ClimateColumn> climates = chunkClimates(m_climate, m_climateCaching, chunk);
+    std::array<float, CaveDensity::HEIGHT> density;
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            int i = x + 16 * z;
+            if (caves != nullptr) {
+                caves->column(x, z, density.data());
+            }
+            fillColumn(chunk, x, z, climates[i], static_cast<int>(caveCeilHeights[i]),
+                       caves != nullptr ? density.data() : nullptr);
+        }
     }
+}
 
-    for (int k = 64; k < 75; k++) {
-        if (chunk->getBlockAt(x, k, z) == EMPTY) {
-            chunk->setBlockAt(x, k, z, LAVA);
+void Terrain::decorateChunk(Chunk *chunk) {
+    // MOUNTAIN columns take fbm() of their position within the Chunk,
+    // which is the same for every Chunk
+    static const std::array<float, 256> localFbm = []() {
+        std::array<float, 256> x, z, noise;
+        for (int i = 0; i < 256; i++) {
+            x[i] = i & 15;
+            z[i] = i >> 4;
+        }
+        fbmBatch(x.data(), z.data(), noise.data(), 256);
+        return noise;
+    }();
+
+    std::vector<ClimateColumn> climates = chunkClimates(m_climate, m_climateCaching, chunk);
+    std::array<float, 256> decorationNoise;
+    std::array<float, 256> sandX, sandZ, sandNoise;
+    std::array<int, 256> sandColumns;
+    int sandCount = 0;
+    for (int i = 0; i < 256; i++) {
+        decorationNoise[i] = climates[i].biome == MOUNTAIN ? localFbm[i] : 0;
+        if (climates[i].biome == SANDLAND) {
+            sandX[sandCount] = chunk->m_pos[0] + (i & 15);
+            sandZ[sandCount] = chunk->m_pos[1] + (i >> 4);
+            sandColumns[sandCount++] = i;
         }
     }
+    fbmBatch(sandX.data(), sandZ.data(), sandNoise.data(), sandCount);
+    for (int s = 0; s < sandCount; s++) {
+        decorationNoise[sandColumns[s]] = sandNoise[s];
+    }
 
-    for (int k = 127; k > 127 - caveCeilHeight; k--) {
-        if ( k <= 64 + caveFloorHeight) {
-            break;
+    DecorationWriter writer(chunk);
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            int i = x + 16 * z;
+            decorateColumn(writer, chunk, x, z, climates[i], decorationNoise[i]);
         }
-        chunk->setBlockAt(x, k, z, STONE);
     }
+}
 
-    float pi = 3.14159f;
+// Whether world block (x, y, z) is in the pit cleared around the spawn
+// point, which decorations must leave empty too
+static bool inSpawnClearing(int x, int y, int z) {
+    return x > 44 && x < 52 && z > 44 && z < 52 && y >= 100 && y < 150;
+}
 
+void Terrain::fillColumn(Chunk *chunk, int x, int z, const ClimateColumn &climate,
+                         int caveCeilHeight, const float *caveDensity) {
 
-    float moist = moisture(glm::vec2(map_x * cos(pi * 0.25) - sin(pi * 0.25) * map_z,
-                                     map_x * sin(pi * 0.25) + cos(pi * 0.25) * map_z) / 1000.f);
-//    float moist = moisture(glm::vec2(map_x, map_z) / 500.f);
-    moist = 0.5 * (moist + 1);
-    float temperature = moisture(glm::vec2(map_x * cos(pi * 0.45) - sin(pi * 0.45) * map_z,
-                                           map_x * sin(pi * 0.45) + cos(pi * 0.45) * map_z) / 1000.f);
-//    std::cout<<moist<<std::endl;
-    temperature = 0.5 * (temperature + 1);
-    float s = glm::smoothstep(0.4f, 0.75f, moist);
-    int maxHeight;
-    float t = glm::smoothstep(0.4f, 0.75f, temperature);
-//    if (t < 0.575){
-//        maxHeight = glm::mix(m, sm , (t + s) / 2.f);
-//    }else{
-//        maxHeight = glm::mix(m, sm , (t + s) / 2.f);
-//    }
+    int map_x = chunk->m_pos[0] + x;
+    int map_z = chunk->m_pos[1] + z;
 
+    // The column starts out EMPTY, so it is written bottom to top in spans
+//     Cave
+    chunk->fillSpan(x, z, 0, 64, BEDROCK); // start from the ground
+    if (caveDensity != nullptr) {
+        // One span per run of solid or open blocks. Open blocks below 75
+        // fill with lava, as the floor of the 2D caves does.
+        for (int k = 0; k < CaveDensity::HEIGHT;) {
+            bool solid = caveDensity[k] > 0.f;
+            int end = k + 1;
+            while (end < CaveDensity::HEIGHT && (caveDensity[end] > 0.f) == solid) {
+                end++;
+            }
+            if (solid) {
+                chunk->fillSpan(x, z, CaveDensity::BOTTOM + k, CaveDensity::BOTTOM + end, STONE);
+            } else {
+                chunk->fillSpan(x, z, CaveDensity::BOTTOM + k, std::min(CaveDensity::BOTTOM + end, 75), LAVA);
+            }
+            k = end;
+        }
+    } else {
+        // The floor has always mirrored the ceiling; caveFloor() is unused
+        int caveFloorHeight = caveCeilHeight;
+        chunk->fillSpan(x, z, 64, 64 + caveFloorHeight, STONE);
+        // Lava fills what's left of the cave floor up to 75
+        chunk->fillSpan(x, z, std::max(64, 64 + caveFloorHeight), 75, LAVA);
+        // The ceiling hangs down from 127 but stops short of the floor
+        chunk->fillSpan(x, z, std::max(128 - caveCeilHeight, 65 + caveFloorHeight), 128, STONE);
+    }
 
+    int maxHeight = climate.height;
+    BiomeType currentBiome = climate.biome;
 
-//    int maxHeight = sm;
-//    std::cout<<moist<<std::endl;
-    float p = desert(glm::vec2(map_x * cos(pi * 0.33) - sin(pi * 0.33) * map_z,
-                               map_x * sin(pi * 0.33) + cos(pi * 0.33) * map_z), 300, 128);
-    float sm = grassland(glm::vec2(map_x, map_z), 50, 148);
-    float sp = desert(glm::vec2(map_x * cos(pi * 0.20) - sin(pi * 0.20) * map_z,
-                                    map_x * sin(pi * 0.20) + cos(pi * 0.20) * map_z), 100, 148);
-    float m = desert(glm::vec2(map_x * cos(pi * 0.20) - sin(pi * 0.20) * map_z,
-                                    map_x * sin(pi * 0.20) + cos(pi * 0.20) * map_z), 200, 148);
-    float mediuma = glm::mix(p, m, s);
-    float mediumb = glm::mix(sp, sm, s);
-    BiomeType currentBiome;
-    float threshold = 0.6;
-    if (s < threshold && t > threshold){
-        currentBiome = GRASSLAND;
+    // One span per run of the same BlockType
+    for (int k = 128; k <= maxHeight;) {
+        enum BlockType type = BlockType(k, maxHeight, currentBiome);
+        int end = k + 1;
+        while (end <= maxHeight && BlockType(end, maxHeight, currentBiome) == type) {
+            end++;
+        }
+        chunk->fillSpan(x, z, k, end, type);
+        k = end;
+    }
 
-        maxHeight = glm::mix(mediuma, mediumb , t);
+    if (currentBiome == ISLAND){
+        chunk->fillSpan(x, z, maxHeight + 1, 165, WATER);
     }
-    else if (s > threshold && t < threshold){
-        currentBiome = SANDLAND;
-        maxHeight = glm::mix(mediuma, mediumb , t);
-//        maxHeight = mountain(glm::vec2(map_x, map_z));
-    }else if (s > threshold && t > threshold){
-        currentBiome = MOUNTAIN;
-        maxHeight = glm::mix(mediuma, mediumb , t);
-    }else{
-        currentBiome = ISLAND;
-        maxHeight = glm::mix(mediuma, mediumb , t);
+    else if (currentBiome == GRASSLAND){
+        chunk->fillSpan(x, z, maxHeight + 1, 165, GRASS);
+    }else if (currentBiome == SANDLAND){
+        chunk->fillSpan(x, z, maxHeight + 1, 165, SAND);
+    }else if (currentBiome == MOUNTAIN){
+        chunk->fillSpan(x, z, maxHeight + 1, 165, ICE);
     }
 
 
-    for (int k = 128; k <= maxHeight; k++) {
-        chunk->setBlockAt(x, k, z, BlockType(k, maxHeight, currentBiome));
-//        chunk->setBlockAt(x, k, z, BlockType(k, maxHeight, currentBiome));
+    if (inSpawnClearing(map_x, 100, map_z)) {
+        chunk->fillSpan(x, z, 100, 150, EMPTY);
     }
+}
+
+void Terrain::decorateColumn(DecorationWriter &writer, Chunk *chunk, int x, int z,
+                             const ClimateColumn &climate, float decorationNoise) {
+
+    int map_x = chunk->m_pos[0] + x;
+    int map_z = chunk->m_pos[1] + z;
 
+    int maxHeight = climate.height;
+    BiomeType currentBiome = climate.biome;
 
     if (currentBiome == ISLAND){
         float decide = moisture(glm::vec2(map_x, map_z) / 50.f);
-        for (int k = maxHeight + 1; k < 165; k++) {
-            chunk->setBlockAt(x, k, z, WATER);
-
-        }
         if (maxHeight == 163){
-            chunk->setBlockAt(x, maxHeight + 2, z, PAD);
+            writer.set(x, maxHeight + 2, z, PAD);
         }
         if (maxHeight > 165){
 //            std::cout<<decide<<std::endl;
             if (decide > 0.7){
-                chunk->setBlockAt(x, maxHeight + 1, z, ROSE);
+                writer.set(x, maxHeight + 1, z, ROSE);
             }else if (decide > 0.6){
-                chunk->setBlockAt(x, maxHeight + 1, z, YELLOWFLOWER);
+                writer.set(x, maxHeight + 1, z, YELLOWFLOWER);
             }
             else if (decide > 0.5){
-                chunk->setBlockAt(x, maxHeight + 1, z, ANGELBREATH);
+                writer.set(x, maxHeight + 1, z, ANGELBREATH);
             }
         }
 //        else if (maxHeight == 162){
-//            chunk->setBlockAt(x, maxHeight + 2, z, PAD);
+//            writer.set(x, maxHeight + 2, z, PAD);
 //        }
     }
     else if (currentBiome == GRASSLAND){
         float decide;
-        for (int k = maxHeight+1; k < 165; k++) {
-            chunk->setBlockAt(x, k, z, GRASS);
-
-        }
         if (maxHeight > 170){
             decide = moisture(glm::vec2(map_x, map_z) / 20.f);
             if (decide > 0.5){
-                chunk->setBlockAt(x, maxHeight + 1, z, BAMBOO);
-                chunk->setBlockAt(x, maxHeight + 2, z, BAMBOO);
-                chunk->setBlockAt(x, maxHeight + 3, z, BAMBOO);
+                writer.set(x, maxHeight + 1, z, BAMBOO);
+                writer.set(x, maxHeight + 2, z, BAMBOO);
+                writer.set(x, maxHeight + 3, z, BAMBOO);
             }
         }else if (maxHeight <= 170 && maxHeight > 165){
             decide = moisture(glm::vec2(map_x, map_z) / 5.f);
             if (decide > 0.4){
-                chunk->setBlockAt(x, maxHeight + 1, z, MUSHROOM);
+                writer.set(x, maxHeight + 1, z, MUSHROOM);
             }
         }
     }else if (currentBiome == SANDLAND){
-        float decide = fbm(glm::vec2(map_x, map_z));
-        for (int k = maxHeight+1; k < 165; k++) {
-            chunk->setBlockAt(x, k, z, SAND);
-        }
-
+        float decide = decorationNoise;
         if (maxHeight > 170){
 
 //            std::cout<<decide<<std::endl;
             if (decide > 1.75){
-                chunk->setBlockAt(x, maxHeight + 1, z, PUMPKIN);
+                writer.set(x, maxHeight + 1, z, PUMPKIN);
             }else if (decide > 1.7){
-                chunk->setBlockAt(x, maxHeight + 1, z, CAKE);
+                writer.set(x, maxHeight + 1, z, CAKE);
             }
         }else{
             if (decide > 1.7){
-                chunk->setBlockAt(x, maxHeight + 1, z, CACTUS);
-                chunk->setBlockAt(x, maxHeight + 2, z, CACTUS);
-                chunk->setBlockAt(x, maxHeight + 3, z, CACTUS);
+                writer.set(x, maxHeight + 1, z, CACTUS);
+                writer.set(x, maxHeight + 2, z, CACTUS);
+                writer.set(x, maxHeight + 3, z, CACTUS);
             }
         }
     }else if (currentBiome == MOUNTAIN){
-        float decide = fbm(glm::vec2(x, z));
-        for (int k = maxHeight+1; k < 165; k++) {
-            chunk->setBlockAt(x, k, z, ICE);
-        }
+        float decide = decorationNoise;
         if (maxHeight < 190){
             if (decide > 1.7){
-                chunk->setBlockAt(x, maxHeight + 1, z, FIRE);
+                writer.set(x, maxHeight + 1, z, FIRE);
             }
         }else if (maxHeight < 200){
             if (decide > 1.7){
-                placeTree(chunk, x, maxHeight, z, MOUNTAIN);
+                placeTree(writer, x, maxHeight, z, MOUNTAIN);
             }
         }
     }
-
-
-    if (map_x > 44 && map_x < 52 && map_z > 44 && map_z < 52) {
-        for (int k = 100; k < 150; k++) {
-            chunk->setBlockAt(x, k, z, EMPTY);
-        }
-    }
 }
 
 
@@ -460,47 +719,54 @@ BlockType Terrain::BlockType(int height, int maxHeight, enum BiomeType biome) {
     }
 }
 
-void Terrain::placeTree(Chunk* chunk, int x, int y, int z, BiomeType currentBiome){
+void Terrain::placeTree(DecorationWriter &writer, int x, int y, int z, BiomeType currentBiome){
     if (currentBiome == MOUNTAIN){
-        chunk->setBlockAt(x, y + 1, z, WHITETREESTEM);
-        chunk->setBlockAt(x, y + 2, z, WHITETREESTEM);
-//        chunk->setBlockAt(x, y + 3, z, WHITETREESTEM);
-        chunk->setBlockAt(x, y + 3, z, MOUNTAINLEAF);
-        chunk->setBlockAt(x, y + 4, z, MOUNTAINLEAF);
-        chunk->setBlockAt(x, y + 5, z, MOUNTAINLEAF);
-        if (x - 1 >= 0 && z - 1 >= 0){
-             chunk->setBlockAt(x - 1, y + 3, z - 1, MOUNTAINLEAF);
-             chunk->setBlockAt(x - 1, y + 4, z - 1, MOUNTAINLEAF);
-        }
-        if (x + 1 < 16 && z - 1 >= 0){
-             chunk->setBlockAt(x + 1, y + 3, z - 1, MOUNTAINLEAF);
-             chunk->setBlockAt(x + 1, y + 4, z - 1, MOUNTAINLEAF);
-        }
-        if (z + 1 >= 0 && x - 1 < 16){
-             chunk->setBlockAt(x - 1, y + 3, z + 1, MOUNTAINLEAF);
-             chunk->setBlockAt(x - 1, y + 4, z + 1, MOUNTAINLEAF);
-        }
-        if (z + 1 <16 && x + 1 < 16){
-             chunk->setBlockAt(x + 1, y + 3, z + 1, MOUNTAINLEAF);
-             chunk->setBlockAt(x + 1, y + 4, z + 1, MOUNTAINLEAF);
-        }
-        if (x - 1 >= 0){
-             chunk->setBlockAt(x - 1, y + 3, z, MOUNTAINLEAF);
-             chunk->setBlockAt(x - 1, y + 4, z, MOUNTAINLEAF);
-        }
-        if (x + 1 < 16){
-             chunk->setBlockAt(x + 1, y + 3, z, MOUNTAINLEAF);
-             chunk->setBlockAt(x + 1, y + 4, z, MOUNTAINLEAF);
-        }
-        if (z - 1 >= 0){
-             chunk->setBlockAt(x, y + 3, z - 1, MOUNTAINLEAF);
-             chunk->setBlockAt(x, y + 4, z - 1, MOUNTAINLEAF);
+        writer.set(x, y + 1, z, WHITETREESTEM);
+        writer.set(x, y + 2, z, WHITETREESTEM);
+//        writer.set(x, y + 3, z, WHITETREESTEM);
+        writer.set(x, y + 3, z, MOUNTAINLEAF);
+        writer.set(x, y + 4, z, MOUNTAINLEAF);
+        writer.set(x, y + 5, z, MOUNTAINLEAF);
+        // The ring of leaves around the trunk may reach into neighboring Chunks
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                if (dx != 0 || dz != 0) {
+                    writer.fill(x + dx, y + 3, z + dz, MOUNTAINLEAF);
+                    writer.fill(x + dx, y + 4, z + dz, MOUNTAINLEAF);
+                }
+            }
         }
-        if (z + 1 <16){
-             chunk->setBlockAt(x, y + 3, z + 1, MOUNTAINLEAF);
-             chunk->setBlockAt(x, y + 4, z + 1, MOUNTAINLEAF);
+    }
+}
+
+
+DecorationWriter::DecorationWriter(Chunk *chunk)
+    : mp_chunk(chunk)
+{}
+
+void DecorationWriter::set(int x, int y, int z, enum BlockType t) {
+    if (inSpawnClearing(mp_chunk->m_pos[0] + x, y, mp_chunk->m_pos[1] + z)) {
+        return;
+    }
+    mp_chunk->setBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y),
+                         static_cast<unsigned int>(z), t);
+}
+
+void DecorationWriter::fill(int x, int y, int z, enum BlockType t) {
+    if (y < 0 || y > 255 || inSpawnClearing(mp_chunk->m_pos[0] + x, y, mp_chunk->m_pos[1] + z)) {
+        return;
+    }
+    int dx = x < 0 ? -1 : (x > 15 ? 1 : 0);
+    int dz = z < 0 ? -1 : (z > 15 ? 1 : 0);
+    if (dx == 0 && dz == 0) {
+        if (mp_chunk->getBlockAt(x, y, z) == EMPTY) {
+            set(x, y, z, t);
         }
+        return;
     }
+    mp_chunk->m_spilled[(dx + 1) + 3 * (dz + 1)].push_back(PendingWrite{static_cast<unsigned char>(x & 15),
+                                                                        static_cast<unsigned char>(y),
+                                                                        static_cast<unsigned char>(z & 15), t});
 }
 
 
@@ -525,7 +791,13 @@ uPtr<Chunk>& Terrain::getNewChunkAt(int x, int z) {
 }
 
 
-void Terrain::updateTerrian(glm::vec3 currPlayerPos) {
+void Terrain::updateTerrian(glm::vec3 currPlayerPos, glm::vec3 forward) {
+    m_grid.recenter(static_cast<int>(glm::floor(currPlayerPos.x)) >> 4,
+                    static_cast<int>(glm::floor(currPlayerPos.z)) >> 4,
+                    [this](int cx, int cz) -> Chunk* {
+                        auto it = m_chunks.find(toKey(16 * cx, 16 * cz));
+                        return it == m_chunks.end() ? nullptr : it->second.get();
+                    });
 
     int r = 2; // 5x5
     std::vector<glm::ivec2> newZones = getSurroundingZones(currPlayerPos.x, currPlayerPos.z, r);
@@ -536,7 +808,18 @@ void Terrain::updateTerrian(glm::vec3 currPlayerPos) {
             m_generatedTerrain.insert(toKey(newZone.x, newZone.y));
             for (int x = 0; x < 64; x += 16) {
                 for (int z = 0; z < 64; z += 16) {
-                    newChunkBuffer[toKey(newZone.x + x, newZone.y + z)] = mkU<Chunk>(mp_context, newZone[0]+x, newZone[1]+z);
+                    uPtr<Chunk> &chunk = newChunkBuffer[toKey(newZone.x + x, newZone.y + z)];
+                    chunk = mkU<Chunk>(mp_context, newZone[0]+x, newZone[1]+z);
+                    m_inFlight[toKey(newZone.x + x, newZone.y + z)] =
+                            InFlightChunk{chunk.get(), STAGE_GENERATING, std::chrono::steady_clock::now()};
+                    // What its neighbors' decorations placed in it before
+                    // it was last unloaded
+                    auto spills = m_spills.find(toKey(newZone.x + x, newZone.y + z));
+                    if (spills != m_spills.end()) {
+                        for (const std::vector<PendingWrite> &writes : spills->second) {
+                            chunk->queueWrites(writes);
+                        }
+                    }
 
                 }
             }
@@ -544,6 +827,13 @@ void Terrain::updateTerrian(glm::vec3 currPlayerPos) {
     }
 
 
+    glm::ivec2 playerZone(64 * static_cast<int>(glm::floor(currPlayerPos.x / 64.f)),
+                          64 * static_cast<int>(glm::floor(currPlayerPos.z / 64.f)));
+    if (m_storage != nullptr && playerZone != m_lastPlayerZone) {
+        prefetchZonesAhead(playerZone, playerZone - m_lastPlayerZone, r);
+    }
+    m_lastPlayerZone = playerZone;
+
     for (auto & [key, chunk]: newChunkBuffer) {
         // link to neighbour
         instantiateChunkAt(chunk->m_pos[0], chunk->m_pos[1]);
@@ -561,8 +851,15 @@ void Terrain::updateTerrian(glm::vec3 currPlayerPos) {
 
     }
 
+    // Zones are generated out to r zones from the player's, so the
+    // furthest Chunk center in range is under (r + 1) * 64 * sqrt(2) away.
+    // Jobs are only cancelled a zone past that, so that walking back and
+    // forth over a zone boundary doesn't keep parking and resuming them.
+    float resumeRadius = (r + 1) * 64 * 1.5f;
+    m_scheduler->reprioritize(currPlayerPos, forward, resumeRadius, resumeRadius + 64.f);
+
     for (auto & [key, chunk]: newChunkBuffer) {
-        BlockTypeWorkers.push_back(std::thread(&Terrain::BlockTypeWorker, this, move(chunk)));
+        m_scheduler->schedule(chunk.release(), ChunkScheduler::GENERATE);
     }
 
 //    for (Chunk *c : newChunks){
@@ -570,58 +867,588 @@ void Terrain::updateTerrian(glm::vec3 currPlayerPos) {
 //    }
 
 
-    newChunkBuffer.clear(); // all uPtrs have been moved
+    newChunkBuffer.clear(); // all uPtrs have been released to the workers
+
+    Chunk *c;
+    while (BlockTypeBuffer.tryPop(c)) {
+        m_inFlight.at(toKey(c->m_pos[0], c->m_pos[1])).stage = STAGE_GENERATED;
+        advanceNeighborhood(c->m_pos[0], c->m_pos[1]);
+    }
+    while (DecorationBuffer.tryPop(c)) {
+        handOnSpills(c);
+        m_inFlight.at(toKey(c->m_pos[0], c->m_pos[1])).stage = STAGE_DECORATED;
+        advanceNeighborhood(c->m_pos[0], c->m_pos[1]);
+    }
+
+    glm::vec2 playerXZ(currPlayerPos.x, currPlayerPos.z);
+    glm::vec2 forwardXZ(forward.x, forward.z);
+    if (glm::length(forwardXZ) > 0.001f) {
+        forwardXZ = glm::normalize(forwardXZ);
+    }
 
-    BlockTypeBufferMutex.lock();
-    for (auto & [key, chunk] : BlockTypeBuffer) {
-        VBOWorkers.push_back(std::thread(&Terrain::VBOWorker, this, move(chunk)));
+    while (VBOdataBuffer.tryPop(c)) {
+        m_inFlight.at(toKey(c->m_pos[0], c->m_pos[1])).stage = STAGE_MESHED;
+        m_pendingUploads.push_back(c);
     }
-    BlockTypeBuffer.clear(); // all uPtrs have been moved
-    BlockTypeBufferMutex.unlock();
 
-    VBOdataBufferMutex.lock();
-    for (auto & [key, chunk] : VBOdataBuffer) {
+    // Nearest last, so uploading pops from the back
+    std::sort(m_pendingUploads.begin(), m_pendingUploads.end(), [playerXZ](const Chunk *a, const Chunk *b) {
+        glm::vec2 da = glm::vec2(a->m_pos) + glm::vec2(8.f) - playerXZ;
+        glm::vec2 db = glm::vec2(b->m_pos) + glm::vec2(8.f) - playerXZ;
+        return glm::dot(da, da) > glm::dot(db, db);
+    });
+
+    auto uploadStart = std::chrono::steady_clock::now();
+    float uploadMs = 0.f;
+    long long uploadBytes = 0;
+    int uploaded = 0;
+    // Always upload at least one Chunk, so a budget smaller than a single
+    // upload still makes progress
+    while (!m_pendingUploads.empty() &&
+           (uploaded == 0 ||
+            ((m_uploadBudgetMs <= 0.f || uploadMs < m_uploadBudgetMs) &&
+             (m_uploadBudgetBytes <= 0 || uploadBytes < m_uploadBudgetBytes)))) {
+        uPtr<Chunk> chunk(m_pendingUploads.back());
+        m_pendingUploads.pop_back();
         chunk->sendVBOdata();
+        uploadBytes += chunk->meshStats().vertices * static_cast<long long>(sizeof(PackedVertex));
+        uploaded++;
+        uploadMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+
+        auto queued = m_inFlight.find(toKey(chunk->m_pos[0], chunk->m_pos[1]));
+        if (queued != m_inFlight.end()) {
+            // Within about 15 degrees of the crosshair, ignoring height
+            glm::vec2 offset = glm::vec2(chunk->m_pos) + glm::vec2(8.f) - playerXZ;
+            if (glm::length(offset) > 0.f && glm::dot(glm::normalize(offset), forwardXZ) > 0.966f) {
+                m_loadStats.crosshairMs = std::chrono::duration<float, std::milli>(
+                            std::chrono::steady_clock::now() - queued->second.queuedAt).count();
+                m_loadStats.crosshairChunks++;
+                m_loadStats.averageCrosshairMs += (m_loadStats.crosshairMs - m_loadStats.averageCrosshairMs)
+                                                  / m_loadStats.crosshairChunks;
+            }
+            m_inFlight.erase(queued);
+        }
+
         // after vbo being sent to GPU, it should be considered as created, therefore store it in m_chunks
-        m_chunks[key] = move(chunk);
+        uPtr<Chunk> &slot = m_chunks[toKey(chunk->m_pos[0], chunk->m_pos[1])];
+        if (slot) {
+            std::replace(m_renderList.begin(), m_renderList.end(), slot.get(), chunk.get());
+        } else {
+            m_renderList.push_back(chunk.get());
+        }
+        m_grid.set(chunk->m_pos.x >> 4, chunk->m_pos.y >> 4, chunk.get());
+        slot = move(chunk);
+    }
+
+    m_uploadHistory[m_uploadFrame++ % m_uploadHistory.size()] = uploadMs;
+    m_loadStats.uploadMs = uploadMs;
+    m_loadStats.worstUploadMs = *std::max_element(m_uploadHistory.begin(), m_uploadHistory.end());
+    m_loadStats.uploadBytes = uploadBytes;
+    m_loadStats.uploadedChunks = uploaded;
+    m_loadStats.pendingUploads = static_cast<int>(m_pendingUploads.size());
+    m_loadStats.chunksWaiting = 0;
+    for (auto & [key, inFlight] : m_inFlight) {
+        if (inFlight.stage == STAGE_GENERATED || inFlight.stage == STAGE_DECORATED) {
+            m_loadStats.chunksWaiting++;
+        }
     }
-    VBOdataBuffer.clear(); // all uPtrs have been moved
-    VBOdataBufferMutex.unlock();
 
+    unloadDistantZones(currPlayerPos, r);
+
+    ChunkScheduler::Stats jobs = m_scheduler->stats();
+    m_loadStats.jobsQueued = jobs.queued;
+    m_loadStats.jobsParked = jobs.parked;
+    m_loadStats.jobsCancelled = jobs.cancelled;
 }
 
+const ChunkLoadStats& Terrain::loadStats() const {
+    return m_loadStats;
+}
 
-void Terrain::BlockTypeWorker(uPtr<Chunk> chunk) {
+void Terrain::setPrioritizedLoading(bool prioritized) {
+    m_scheduler->setPrioritized(prioritized);
+}
 
-    for (int x = 0; x < 16; x++) {
-        for (int z = 0; z < 16; z++) {
-            fillColumn(chunk.get(), x, z);
+bool Terrain::prioritizedLoading() const {
+    return m_scheduler->prioritized();
+}
+
+// Blocks plus the GPU copy of the mesh. The CPU copy of the mesh goes back
+// to ChunkSection's buffer pool once it's uploaded.
+static size_t chunkMemoryUsage(const Chunk &chunk) {
+    return chunk.blockMemoryUsage() + chunk.meshStats().vertices * sizeof(PackedVertex);
+}
+
+int Terrain::stageAt(int x, int z) const {
+    auto inFlight = m_inFlight.find(toKey(x, z));
+    if (inFlight != m_inFlight.end()) {
+        return inFlight->second.stage;
+    }
+    return m_chunks.count(toKey(x, z)) > 0 ? STAGE_MESHED : -1;
+}
+
+bool Terrain::neighborhoodReached(int x, int z, ChunkStage stage) const {
+    for (int dx = -16; dx <= 16; dx += 16) {
+        for (int dz = -16; dz <= 16; dz += 16) {
+            if (stageAt(x + dx, z + dz) < stage) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Terrain::advanceNeighborhood(int x, int z) {
+    for (int dx = -16; dx <= 16; dx += 16) {
+        for (int dz = -16; dz <= 16; dz += 16) {
+            auto it = m_inFlight.find(toKey(x + dx, z + dz));
+            if (it == m_inFlight.end()) {
+                continue;
+            }
+            InFlightChunk &inFlight = it->second;
+            // Decorations may spill into any of the eight neighbors, and
+            // meshing reads the edges they spilled into
+            if (inFlight.stage == STAGE_GENERATED && neighborhoodReached(x + dx, z + dz, STAGE_GENERATED)) {
+                inFlight.stage = STAGE_DECORATING;
+                m_scheduler->schedule(inFlight.chunk, ChunkScheduler::DECORATE);
+            } else if (inFlight.stage == STAGE_DECORATED && neighborhoodReached(x + dx, z + dz, STAGE_DECORATED)) {
+                inFlight.stage = STAGE_MESHING;
+                m_scheduler->schedule(inFlight.chunk, ChunkScheduler::MESH);
+            }
+        }
+    }
+}
+
+void Terrain::zoneJobs(int64_t zone, std::vector<Chunk*> &chunks, std::vector<Chunk*> &neighbors) const {
+    glm::ivec2 corner = toCoords(zone);
+    for (int x = -16; x <= 64; x += 16) {
+        for (int z = -16; z <= 64; z += 16) {
+            auto it = m_inFlight.find(toKey(corner.x + x, corner.y + z));
+            if (it == m_inFlight.end() || (it->second.stage != STAGE_GENERATING &&
+                                           it->second.stage != STAGE_DECORATING &&
+                                           it->second.stage != STAGE_MESHING)) {
+                continue;
+            }
+            bool inZone = x >= 0 && x < 64 && z >= 0 && z < 64;
+            (inZone ? chunks : neighbors).push_back(it->second.chunk);
+        }
+    }
+}
+
+void Terrain::discardInFlight(Chunk *chunk, bool complete) {
+    // Until all its neighbors have decorated, some of their decorations may
+    // still be missing from it, so it is generated again next time instead
+    if (m_storage != nullptr && complete) {
+        chunk->applyPendingWrites();
+        if (chunk->unsaved()) {
+            m_storage->save(chunk);
+        }
+        m_spills.erase(toKey(chunk->m_pos[0], chunk->m_pos[1]));
+    } else if (m_storage == nullptr || chunk->unsaved()) {
+        // Not loaded from m_storage either
+        forgetSpillsFrom(chunk->m_pos[0], chunk->m_pos[1]);
+    }
+    delete chunk;
+}
+
+void Terrain::handOnSpills(Chunk *chunk) {
+    for (int i = 0; i < 9; i++) {
+        std::vector<PendingWrite> &writes = chunk->m_spilled[i];
+        if (writes.empty()) {
+            continue;
+        }
+        int64_t key = toKey(chunk->m_pos[0] + 16 * (i % 3 - 1), chunk->m_pos[1] + 16 * (i / 3 - 1));
+        // From the neighbor's side chunk is at the opposite offset
+        m_spills[key][8 - i] = writes;
+        // One that is meshing or uploaded got these the first time chunk was
+        // decorated, and one that doesn't exist gets them when it's created
+        auto inFlight = m_inFlight.find(key);
+        if (inFlight != m_inFlight.end() && inFlight->second.stage < STAGE_MESHING) {
+            inFlight->second.chunk->queueWrites(std::move(writes));
+        }
+        std::vector<PendingWrite>().swap(writes);
+    }
+}
+
+void Terrain::forgetSpillsFrom(int x, int z) {
+    for (int i = 0; i < 9; i++) {
+        auto spills = m_spills.find(toKey(x + 16 * (i % 3 - 1), z + 16 * (i / 3 - 1)));
+        if (spills == m_spills.end()) {
+            continue;
+        }
+        spills->second[8 - i].clear();
+        auto isEmpty = [](const std::vector<PendingWrite> &writes) { return writes.empty(); };
+        if (std::all_of(spills->second.begin(), spills->second.end(), isEmpty)) {
+            m_spills.erase(spills);
+        }
+    }
+}
+
+bool Terrain::canUnloadZone(int64_t zone) const {
+    std::vector<Chunk*> chunks, neighbors;
+    zoneJobs(zone, chunks, neighbors);
+    return m_scheduler->canCancel(chunks, neighbors);
+}
+
+bool Terrain::unloadZone(int64_t zone) {
+    // Jobs that haven't started are dropped, parked ones included, so the
+    // zone doesn't stay loaded for as long as the player is away
+    std::vector<Chunk*> jobs, neighborJobs;
+    zoneJobs(zone, jobs, neighborJobs);
+    if (!m_scheduler->cancel(jobs, neighborJobs)) {
+        return false;
+    }
+
+    glm::ivec2 corner = toCoords(zone);
+    // Decided before any of the zone's Chunks are deleted, since each
+    // depends on its neighbors
+    std::array<bool, 16> complete;
+    for (int i = 0; i < 16; i++) {
+        complete[i] = neighborhoodReached(corner.x + 16 * (i % 4), corner.y + 16 * (i / 4), STAGE_DECORATED);
+    }
+    for (int x = 0; x < 64; x += 16) {
+        for (int z = 0; z < 64; z += 16) {
+            int64_t key = toKey(corner.x + x, corner.y + z);
+            auto inFlight = m_inFlight.find(key);
+            if (inFlight != m_inFlight.end()) {
+                // Never uploaded: waiting on its neighbors or to be
+                // uploaded, or its job was just cancelled
+                if (inFlight->second.stage == STAGE_MESHED) {
+                    m_pendingUploads.erase(std::find(m_pendingUploads.begin(), m_pendingUploads.end(),
+                                                     inFlight->second.chunk));
+                }
+                inFlight->second.chunk->unlinkNeighbors();
+                discardInFlight(inFlight->second.chunk, complete[x / 16 + 4 * (z / 16)]);
+                m_inFlight.erase(inFlight);
+                continue;
+            }
+            auto it = m_chunks.find(key);
+            if (it == m_chunks.end()) {
+                continue;
+            }
+            Chunk *chunk = it->second.get();
+            if (m_storage != nullptr) {
+                if (chunk->unsaved()) {
+                    m_storage->save(chunk);
+                }
+                m_spills.erase(key);
+            } else {
+                forgetSpillsFrom(chunk->m_pos[0], chunk->m_pos[1]);
+            }
+            chunk->unlinkNeighbors();
+            m_grid.set(chunk->m_pos.x >> 4, chunk->m_pos.y >> 4, nullptr);
+            auto listed = std::find(m_renderList.begin(), m_renderList.end(), chunk);
+            if (listed != m_renderList.end()) {
+                *listed = m_renderList.back();
+                m_renderList.pop_back();
+            }
+            // Releases the Chunk's blocks and its ChunkSection::meshArena() blocks
+            m_chunks.erase(it);
+        }
+    }
+    m_generatedTerrain.erase(zone);
+    m_climate.erase(corner);
+    auto left = m_leftZoneIndex.find(zone);
+    if (left != m_leftZoneIndex.end()) {
+        m_leftZones.erase(left->second);
+        m_leftZoneIndex.erase(left);
+    }
+    m_loadStats.unloadedZones++;
+    return true;
+}
+
+void Terrain::unloadDistantZones(glm::vec3 p, int loadRadius) {
+    glm::ivec2 playerZone(64 * static_cast<int>(glm::floor(p.x / 64.f)),
+                          64 * static_cast<int>(glm::floor(p.z / 64.f)));
+    auto zoneDistance = [playerZone](int64_t zone) {
+        glm::ivec2 offset = glm::abs(toCoords(zone) - playerZone) / 64;
+        return std::max(offset.x, offset.y);
+    };
+    // Zones are loaded out to loadRadius but only start to count as left
+    // one zone further out, so hovering over a boundary doesn't churn them
+    int keepRadius = loadRadius + 1;
+
+    for (auto it = m_leftZones.begin(); it != m_leftZones.end();) {
+        if (zoneDistance(*it) <= keepRadius) {
+            m_leftZoneIndex.erase(*it);
+            it = m_leftZones.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (int64_t zone : m_generatedTerrain) {
+        if (zoneDistance(zone) > keepRadius && m_leftZoneIndex.count(zone) == 0) {
+            m_leftZones.push_front(zone);
+            m_leftZoneIndex[zone] = m_leftZones.begin();
+        }
+    }
+    size_t resident = 0;
+    for (auto & [key, chunk] : m_chunks) {
+        resident += chunkMemoryUsage(*chunk);
+    }
+
+    // Chunks still waiting on their neighbors aren't counted in resident
+    auto zoneMemoryUsage = [this](int64_t zone) {
+        glm::ivec2 corner = toCoords(zone);
+        size_t bytes = 0;
+        for (int x = 0; x < 64; x += 16) {
+            for (int z = 0; z < 64; z += 16) {
+                auto it = m_chunks.find(toKey(corner.x + x, corner.y + z));
+                if (it != m_chunks.end()) {
+                    bytes += chunkMemoryUsage(*it->second);
+                }
+            }
+        }
+        return bytes;
+    };
+
+    // Oldest first, skipping any a worker is still busy with
+    for (auto it = m_leftZones.end(); it != m_leftZones.begin() &&
+         static_cast<int>(m_leftZones.size()) > LEFT_ZONE_CAPACITY;) {
+        int64_t zone = *--it;
+        if (canUnloadZone(zone)) {
+            size_t bytes = zoneMemoryUsage(zone);
+            // Unloading erases it from m_leftZones, so step over it first
+            auto next = std::next(it);
+            if (unloadZone(zone)) {
+                resident -= bytes;
+                it = next;
+            }
+        }
+    }
+
+    if (m_memoryBudget > 0 && resident > m_memoryBudget) {
+        std::vector<int64_t> candidates;
+        for (int64_t zone : m_generatedTerrain) {
+            if (zoneDistance(zone) > loadRadius) {
+                candidates.push_back(zone);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [&zoneDistance](int64_t a, int64_t b) {
+            return zoneDistance(a) > zoneDistance(b);
+        });
+        for (int64_t zone : candidates) {
+            if (resident <= m_memoryBudget) {
+                break;
+            }
+            if (canUnloadZone(zone)) {
+                size_t bytes = zoneMemoryUsage(zone);
+                if (unloadZone(zone)) {
+                    resident -= bytes;
+                }
+            }
         }
     }
-    BlockTypeBufferMutex.lock();
-    BlockTypeBuffer[toKey(chunk->m_pos[0], chunk->m_pos[1])] = move(chunk);
-    BlockTypeBufferMutex.unlock();
+
+    m_loadStats.loadedZones = static_cast<int>(m_generatedTerrain.size());
+    m_loadStats.leftZones = static_cast<int>(m_leftZones.size());
+    m_loadStats.residentBytes = resident;
+}
+
+void Terrain::prefetchZonesAhead(glm::ivec2 playerZone, glm::ivec2 movement, int r) {
+    glm::ivec2 direction = glm::sign(movement);
+    int ring = r + 1;
+    for (int dx = -ring; dx <= ring; dx++) {
+        for (int dz = -ring; dz <= ring; dz++) {
+            if (std::max(std::abs(dx), std::abs(dz)) != ring || dx * direction.x + dz * direction.y <= 0) {
+                continue;
+            }
+            glm::ivec2 zone = playerZone + 64 * glm::ivec2(dx, dz);
+            if (m_generatedTerrain.count(toKey(zone.x, zone.y)) > 0) {
+                continue;
+            }
+            for (int x = 0; x < 64; x += 16) {
+                for (int z = 0; z < 64; z += 16) {
+                    m_storage->prefetch((zone.x + x) >> 4, (zone.y + z) >> 4);
+                }
+            }
+        }
+    }
+}
+
+void Terrain::setClimateCaching(bool enabled) {
+    m_climateCaching = enabled;
+}
+
+bool Terrain::climateCaching() const {
+    return m_climateCaching;
+}
+
+void Terrain::setDensityCaves(bool enabled) {
+    m_densityCaves = enabled;
+}
+
+bool Terrain::densityCaves() const {
+    return m_densityCaves;
+}
+
+void Terrain::setSeed(uint32_t seed) {
+    setNoiseSeed(seed);
+    m_climate.clear();
+}
+
+uint32_t Terrain::seed() const {
+    return noiseSeed();
+}
+
+void Terrain::setWorldStorage(uPtr<WorldStorage> storage) {
+    m_storage = std::move(storage);
+    if (m_storage != nullptr) {
+        setSeed(m_storage->seed(seed()));
+    }
+}
+
+const WorldStorage* Terrain::worldStorage() const {
+    return m_storage.get();
+}
+
+void Terrain::setMemoryBudget(size_t bytes) {
+    m_memoryBudget = bytes;
+}
+
+size_t Terrain::memoryBudget() const {
+    return m_memoryBudget;
+}
+
+void Terrain::setUploadBudget(float ms, long long bytes) {
+    m_uploadBudgetMs = ms;
+    m_uploadBudgetBytes = bytes;
 }
 
+float Terrain::uploadBudgetMs() const {
+    return m_uploadBudgetMs;
+}
+
+long long Terrain::uploadBudgetBytes() const {
+    return m_uploadBudgetBytes;
+}
 
 
-void Terrain::VBOWorker(uPtr<Chunk> chunk) {
+void Terrain::BlockTypeWorker(Chunk *chunk) {
+    bool loaded;
+    {
+        // Neighbors' VBOWorkers wait on this lock before reading our edges
+        std::unique_lock<std::shared_mutex> lock(chunk->blocksMutex());
+        loaded = m_storage != nullptr && m_storage->load(chunk);
+        if (!loaded) {
+            fillChunk(chunk);
+        }
+    }
+    // Saved Chunks already hold their decorations and their neighbors'
+    MPMCQueue<Chunk*> &buffer = loaded ? DecorationBuffer : BlockTypeBuffer;
+    // Only fails if the main thread has fallen thousands of Chunks behind
+    while (!buffer.tryPush(std::move(chunk))) {
+        std::this_thread::yield();
+    }
+}
+
+void Terrain::DecorationWorker(Chunk *chunk) {
+    {
+        std::unique_lock<std::shared_mutex> lock(chunk->blocksMutex());
+        decorateChunk(chunk);
+        chunk->compactBlocks();
+    }
+    while (!DecorationBuffer.tryPush(std::move(chunk))) {
+        std::this_thread::yield();
+    }
+}
+
+void Terrain::VBOWorker(Chunk *chunk) {
+    {
+        // Every neighbor is decorated by now, so nothing more gets queued
+        std::unique_lock<std::shared_mutex> lock(chunk->blocksMutex());
+        chunk->applyPendingWrites();
+    }
     chunk->createVBOdata();
 
-    VBOdataBufferMutex.lock();
-    VBOdataBuffer[toKey(chunk->m_pos[0], chunk->m_pos[1])] = move(chunk);
-    VBOdataBufferMutex.unlock();
+    while (!VBOdataBuffer.tryPush(std::move(chunk))) {
+        std::this_thread::yield();
+    }
 }
 
 
 
 
+size_t Terrain::blockMemoryUsage() const {
+    size_t bytes = 0;
+    for (auto & [key, chunk] : m_chunks) {
+        bytes += chunk->blockMemoryUsage();
+    }
+    return bytes;
+}
+
+int Terrain::chunkCount() const {
+    return static_cast<int>(m_chunks.size());
+}
+
+MeshStats Terrain::averageMeshStats() const {
+    MeshStats average;
+    if (m_chunks.empty()) {
+        return average;
+    }
+    for (auto & [key, chunk] : m_chunks) {
+        average.vertices += chunk->meshStats().vertices;
+        average.indices += chunk->meshStats().indices;
+        average.ms += chunk->meshStats().ms;
+        average.allocations += chunk->meshStats().allocations;
+        average.allocatedBytes += chunk->meshStats().allocatedBytes;
+    }
+    average.vertices /= static_cast<int>(m_chunks.size());
+    average.indices /= static_cast<int>(m_chunks.size());
+    average.ms /= m_chunks.size();
+    average.allocations /= static_cast<int>(m_chunks.size());
+    average.allocatedBytes /= static_cast<long long>(m_chunks.size());
+    return average;
+}
+
+void Terrain::remeshAll() {
+    for (auto & [key, chunk] : m_chunks) {
+        chunk->markAllDirty();
+        chunk->createVBOdata();
+        chunk->sendVBOdata();
+    }
+}
+
 void Terrain::end() {
-    for (auto &thread: BlockTypeWorkers) {
-        thread.join();
+    if (m_workers == nullptr) {
+        return;
+    }
+    // Empty the scheduler first so the pool's remaining tasks find nothing
+    // to do, then stop the pool while they can still reach the scheduler.
+    // Every Chunk the scheduler held is in m_inFlight too.
+    m_scheduler->clear();
+    m_workers.reset();
+    m_scheduler.reset();
+
+    // Chunks the workers handed back are a stage further along than
+    // m_inFlight says
+    Chunk *chunk;
+    while (BlockTypeBuffer.tryPop(chunk)) {
+        m_inFlight.at(toKey(chunk->m_pos[0], chunk->m_pos[1])).stage = STAGE_GENERATED;
+    }
+    while (DecorationBuffer.tryPop(chunk)) {
+        handOnSpills(chunk);
+        m_inFlight.at(toKey(chunk->m_pos[0], chunk->m_pos[1])).stage = STAGE_DECORATED;
+    }
+    while (VBOdataBuffer.tryPop(chunk)) {
+        m_inFlight.at(toKey(chunk->m_pos[0], chunk->m_pos[1])).stage = STAGE_MESHED;
     }
-    for (auto &thread: VBOWorkers) {
-        thread.join();
+    // Nobody is left to upload these, but any whose neighbors have all
+    // decorated are worth keeping
+    for (auto & [key, inFlight] : m_inFlight) {
+        discardInFlight(inFlight.chunk, neighborhoodReached(inFlight.chunk->m_pos[0], inFlight.chunk->m_pos[1],
+                                                            STAGE_DECORATED));
+    }
+    m_inFlight.clear();
+    m_pendingUploads.clear();
+
+    if (m_storage != nullptr) {
+        for (auto & [key, loaded] : m_chunks) {
+            if (loaded->unsaved()) {
+                m_storage->save(loaded.get());
+            }
+        }
+        m_storage->flush();
     }
 }
 
@@ -2,15 +2,22 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include "chunk.h"
+#include "frustum.h"
+#include "chunkgrid.h"
+#include "mpmcqueue.h"
+#include "workerpool.h"
+#include "chunkscheduler.h"
+#include "worldstorage.h"
+#include "zoneclimate.h"
 #include <array>
+#include <chrono>
+#include <list>
 #include <unordered_map>
 #include <unordered_set>
 #include "shaderprogram.h"
 #include "cube.h"
 #include "texture.h"
 
-#include <thread>
-#include <mutex>
 
 #include "biomes.h"
 
@@ -20,6 +27,86 @@
 int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
 
+// What the last Terrain::draw() call cost
+struct DrawStats
+{
+    int drawCalls = 0;
+    // Sections with anything to draw that were drawn
+    int sections = 0;
+    int sectionsCulled = 0;
+    // In the frustum, but not reached by the visibility search
+    int sectionsOccluded = 0;
+    // Chunks in range with anything to draw, sorted by the frustum test
+    int chunksDrawn = 0;
+    int chunksCulled = 0;
+    // CPU time spent in draw(), including issuing the GL calls
+    float cpuMs = 0.f;
+};
+
+// How quickly new Chunks are reaching the screen
+struct ChunkLoadStats
+{
+    // Generation, decoration and meshing jobs waiting in the ChunkScheduler,
+    // and those set aside because the player moved away from their Chunk
+    int jobsQueued = 0;
+    int jobsParked = 0;
+    // Jobs cancel() dropped without running them
+    int jobsCancelled = 0;
+    // Chunks waiting for their neighbors to catch up before being
+    // decorated or meshed
+    int chunksWaiting = 0;
+    // From creating a Chunk in the direction the player is looking to
+    // uploading its mesh, for the last such Chunk and averaged over all
+    float crosshairMs = 0.f;
+    float averageCrosshairMs = 0.f;
+    int crosshairChunks = 0;
+    // What the last updateTerrian() call spent sending meshes to the GPU,
+    // and the most any of the last UPLOAD_HISTORY calls spent
+    float uploadMs = 0.f;
+    float worstUploadMs = 0.f;
+    long long uploadBytes = 0;
+    int uploadedChunks = 0;
+    // Meshed Chunks left for later frames
+    int pendingUploads = 0;
+    // Zones in memory, how many of those are out of range and waiting in
+    // the LRU to be unloaded, and how many have been unloaded so far
+    int loadedZones = 0;
+    int leftZones = 0;
+    int unloadedZones = 0;
+    // Estimated bytes held by the loaded Chunks' blocks and GPU meshes
+    size_t residentBytes = 0;
+};
+
+// Where a Chunk is on its way from being created to being uploaded
+enum ChunkStage : unsigned char
+{
+    STAGE_GENERATING, // Being filled with terrain, or loaded
+    STAGE_GENERATED,  // Waiting for its eight neighbors' terrain
+    STAGE_DECORATING,
+    STAGE_DECORATED,  // Waiting for its eight neighbors' decorations
+    STAGE_MESHING,
+    STAGE_MESHED      // Waiting to be uploaded
+};
+
+// Places the blocks of Terrain::decorateChunk(). Those in the Chunk being
+// decorated are written to it directly; those that spill into one of its
+// eight neighbors are gathered in its Chunk::m_spilled.
+class DecorationWriter
+{
+private:
+    Chunk *mp_chunk;
+
+public:
+    explicit DecorationWriter(Chunk *chunk);
+
+    // (x, y, z) must be in the Chunk
+    void set(int x, int y, int z, BlockType t);
+    // Places t at (x, y, z) if it is EMPTY. x and z may be up to one block
+    // outside the Chunk, in which case the neighbor decides once its
+    // decorations are done.
+    void fill(int x, int y, int z, BlockType t);
+};
+
 // The container class for all of the Chunks in the game.
 // Ultimately, while Terrain will always store all Chunks,
 // not all Chunks will be drawn at any given time as the world
@@ -32,6 +119,9 @@ private:
     // so that we can use them as a key for the map, as objects like std::pairs or
     // glm::ivec2s are not hashable by default, so they cannot be used as keys.
     std::unordered_map<int64_t, uPtr<Chunk>> m_chunks;
+    // The Chunks of m_chunks near the player, for lookups that don't
+    // have to hash
+    ChunkGrid m_grid;
 
     // We will designate every 64 x 64 area of the world's x-z plane
     // as one "terrain generation zone". Every time the player moves
@@ -43,9 +133,9 @@ private:
     // one 64 x 64 area with its lower-left corner at (0, 0).
     // When milestone 1 has been implemented, the Player can move around the
     // world to add more "terrain generation zone" IDs to this set.
-    // While only the 3 x 3 collection of terrain generation zones
-    // surrounding the Player should be rendered, the Chunks
-    // in the Terrain will never be deleted until the program is terminated.
+    // Zones the Player has left stay loaded until unloadDistantZones()
+    // unloads them, oldest first or farthest first, which deletes their
+    // Chunks and removes them from this set.
     std::unordered_set<int64_t> m_generatedTerrain;
 
     // TODO: DELETE ALL REFERENCES TO m_geomCube AS YOU WILL NOT USE
@@ -59,6 +149,58 @@ private:
 
     OpenGLContext* mp_context;
 
+    // Every Chunk in m_chunks, so that draw() can walk them without a
+    // hash lookup per Chunk
+    std::vector<Chunk*> m_renderList;
+    // The sections draw() found in each ChunkSection::meshArena() page,
+    // kept between frames so that gathering them doesn't allocate
+    std::vector<ChunkDrawBatch> m_opaqueBatches;
+    std::vector<ChunkDrawBatch> m_transparentBatches;
+    // Scratch space for the frustum tests in draw()
+    BoxList m_chunkBoxes;
+    BoxList m_sectionBoxes;
+    std::vector<Chunk*> m_candidateChunks;
+    std::vector<ChunkSection*> m_candidateSections;
+    std::vector<unsigned char> m_visible;
+
+    // One step of the visibility search: a section, the face it was
+    // entered through (-1 for the camera's own section), and a bit per
+    // Direction the path to it has moved in so far
+    struct VisibilityStep
+    {
+        Chunk *chunk;
+        int section;
+        int from;
+        int directions;
+    };
+    std::vector<VisibilityStep> m_visibilityQueue;
+    // Whether draw() skips sections the visibility search doesn't reach
+    bool m_occlusionCulling;
+    // Counts draw() calls, so sections can be marked as reached per frame
+    unsigned int m_frame;
+
+    // Walks outward from the camera's section through the faces
+    // ChunkSection::visibility() says are connected, marking every section
+    // in the frustum that it reaches. Returns false if the camera isn't in
+    // a loaded section, in which case nothing is marked.
+    bool findReachableSections(int minX, int maxX, int minZ, int maxZ,
+                               const Frustum &frustum, glm::vec3 cameraPos);
+    // Whether each page is drawn with one multi-draw call or one call
+    // per section
+    bool m_batchedDrawing;
+    DrawStats m_drawStats;
+
+    void drawBatches(std::vector<ChunkDrawBatch> &batches, bool transparent, ShaderProgram *shaderProgram);
+
+    // fillColumn() once its noise is known. caveDensity is the
+    // CaveDensity::column() that carves the cave band, or nullptr to carve
+    // it with the 2D caveCeilHeight instead.
+    void fillColumn(Chunk *chunk, int x, int z, const ClimateColumn &climate,
+                    int caveCeilHeight, const float *caveDensity);
+    // The decorations of one column of decorateChunk(). decorationNoise is
+    // the fbm() that places them in SANDLAND and MOUNTAIN columns.
+    void decorateColumn(DecorationWriter &writer, Chunk *chunk, int x, int z,
+                        const ClimateColumn &climate, float decorationNoise);
 
 
 public:
@@ -72,6 +214,9 @@ public:
     // Do these world-space coordinates lie within
     // a Chunk that exists?
     bool hasChunkAt(int x, int z) const;
+    // The Chunk containing these world-space coordinates, or nullptr.
+    // Checks m_grid first, and m_chunks only outside its window.
+    Chunk* chunkAt(int x, int z) const;
     // Assuming a Chunk exists at these coords,
     // return a mutable reference to it
     uPtr<Chunk>& getChunkAt(int x, int z);
@@ -87,26 +232,52 @@ public:
     // given type.
     void setBlockAt(int x, int y, int z, BlockType t);
     void setBlockAt(glm::vec3 p, BlockType t);
+    // Remeshes the dirty sections of the Chunk containing (x, z)
+    // and of its four neighbors, then sends them to the GPU
+    void rebuildDirtySections(int x, int z);
 
     void terrainUpdate(glm::vec4 playerPos);
 
     // Draws every Chunk that falls within the bounding box
-    // described by the min and max coords, using the provided
-    // ShaderProgram
-    void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
+    // described by the min and max coords and can be seen
+    // from cameraPos through the frustum, using the provided ShaderProgram
+    void draw(int minX, int maxX, int minZ, int maxZ, const Frustum &frustum,
+              glm::vec3 cameraPos, ShaderProgram *shaderProgram);
+    const DrawStats& drawStats() const;
+    // Switches draw() between one draw call per arena page and one per
+    // section, to compare the two
+    void setBatchedDrawing(bool batched);
+    bool batchedDrawing() const;
+    // Switches the visibility search in draw() on and off
+    void setOcclusionCulling(bool enabled);
+    bool occlusionCulling() const;
 
     // Initializes the Chunks that store the 64 x 256 x 64 block scene you
     // see when the base code is run.
     void CreateTestScene();
-    void placeTree(Chunk* chunk, int x, int y, int z, BiomeType currentBiome);
+    // Leaves only fill EMPTY blocks, so trees never cut into the terrain
+    // or the trees of neighboring Chunks
+    void placeTree(DecorationWriter &writer, int x, int y, int z, BiomeType currentBiome);
 
 
     /*
     Milestone 1
     */
 
-    void updateTerrian(glm::vec3 p);
+    // Creates the zones around p, and reorders the generation and meshing
+    // still to do so the Chunks nearest p and in front of forward go first
+    void updateTerrian(glm::vec3 p, glm::vec3 forward);
+    // Fills a column with terrain, without its decorations
     void fillColumn(Chunk *chunk, int x, int z);
+    // Fills every column of chunk, like calling fillColumn() on each, but
+    // evaluates the noise for all of them at once with the batched kernels
+    // in noisebatch.h
+    void fillChunk(Chunk *chunk);
+    // Adds the flowers, cacti, bamboo and trees of a Chunk filled by
+    // fillChunk(). Blocks that land in a neighbor are left in
+    // chunk->m_spilled, for the caller to queue on the neighbor with
+    // Chunk::queueWrites().
+    void decorateChunk(Chunk *chunk);
     BlockType BlockType(int height, int maxHeight, enum::BiomeType biome);
     std::vector<glm::ivec2> getSurroundingZones(int x, int z, int r = 2);
     bool hasZoneAt(int x, int z) const;
@@ -116,25 +287,185 @@ public:
     Milestone 2
     */
 
-    std::vector<std::thread> BlockTypeWorkers;
-    std::vector<std::thread> VBOWorkers;
-
-    void BlockTypeWorker(uPtr<Chunk> chunk);
-    void VBOWorker(uPtr<Chunk> chunk);
+    // Generation, decoration and meshing tasks, run in that order as each
+    // Chunk's neighbors allow. BlockTypeWorker fills the terrain, or loads the
+    // Chunk from m_storage if it was saved, decorations and all.
+    // DecorationWorker decorates it, and VBOWorker places the blocks its
+    // neighbors' decorations queued on it and meshes it. Each takes
+    // ownership of its Chunk and hands it back to the main thread through
+    // BlockTypeBuffer, DecorationBuffer or VBOdataBuffer when it's done.
+    void BlockTypeWorker(Chunk *chunk);
+    void DecorationWorker(Chunk *chunk);
+    void VBOWorker(Chunk *chunk);
 
 
 
     std::unordered_map<int64_t, uPtr<Chunk>> newChunkBuffer;
-    std::unordered_map<int64_t, uPtr<Chunk>> BlockTypeBuffer;
-    std::mutex BlockTypeBufferMutex;
-    std::unordered_map<int64_t, uPtr<Chunk>> VBOdataBuffer;
-    std::mutex VBOdataBufferMutex;
+    // Chunks filled with terrain, waiting for updateTerrian() to have them decorated
+    MPMCQueue<Chunk*> BlockTypeBuffer;
+    // Chunks decorated or loaded, waiting for updateTerrian() to have them meshed
+    MPMCQueue<Chunk*> DecorationBuffer;
+    // Chunks meshed, waiting for updateTerrian() to upload them
+    MPMCQueue<Chunk*> VBOdataBuffer;
+    // The coarse climate of each zone being generated, which fillColumn()
+    // interpolates instead of evaluating the noise per column
+    ZoneClimateCache m_climate;
+    std::atomic<bool> m_climateCaching;
+    // Whether fillColumn() carves the caves from CaveDensity or from the
+    // caveCeil() height field
+    std::atomic<bool> m_densityCaves;
+    // Where Chunks are saved when unloaded and loaded from instead of being
+    // generated, or nullptr to keep nothing. Declared before m_workers
+    // since BlockTypeWorker loads through it.
+    uPtr<WorldStorage> m_storage;
+    // The zone the player was in last updateTerrian(), to tell which way
+    // they're heading
+    glm::ivec2 m_lastPlayerZone;
+    // Has m_storage start reading the saved Chunks of the ungenerated zones
+    // just beyond radius r of playerZone, on the side the player is moving
+    // towards, so they're in memory by the time they're loaded
+    void prefetchZonesAhead(glm::ivec2 playerZone, glm::ivec2 movement, int r);
+    // Decides which BlockTypeWorker, DecorationWorker or VBOWorker job
+    // m_workers runs next. Declared before m_workers since the pool's tasks
+    // call into it.
+    uPtr<ChunkScheduler> m_scheduler;
+    // Runs BlockTypeWorker, DecorationWorker and VBOWorker. Declared after
+    // the buffers they fill so that it stops first.
+    uPtr<WorkerPool> m_workers;
+    // Every Chunk created but not yet uploaded. A job owns the Chunk while
+    // it is GENERATING, DECORATING or MESHING, m_pendingUploads once it is
+    // MESHED, and this map the rest of the time.
+    struct InFlightChunk
+    {
+        Chunk *chunk;
+        ChunkStage stage;
+        // When it was created, for ChunkLoadStats
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+    std::unordered_map<int64_t, InFlightChunk> m_inFlight;
+    // The stage of the Chunk with corner (x, z): STAGE_MESHED once it has
+    // been uploaded, and -1 if there is no such Chunk
+    int stageAt(int x, int z) const;
+    // Whether the Chunk with corner (x, z) and its eight neighbors have all
+    // reached stage
+    bool neighborhoodReached(int x, int z, ChunkStage stage) const;
+    // Schedules the next job of each Chunk around (x, z) whose neighbors
+    // have caught up with it
+    void advanceNeighborhood(int x, int z);
+    // The in-flight Chunks a job may hold, because they are GENERATING,
+    // DECORATING or MESHING: those in the zone in chunks, and those in the
+    // ring of Chunks around it in neighbors
+    void zoneJobs(int64_t zone, std::vector<Chunk*> &chunks, std::vector<Chunk*> &neighbors) const;
+    // Deletes a Chunk that was never uploaded, first saving it if it is
+    // complete, i.e. it and its eight neighbors have all decorated
+    void discardInFlight(Chunk *chunk, bool complete);
+    // The blocks each Chunk's neighbors' decorations placed in it, indexed
+    // by the neighbor's offset as in Chunk::m_spilled. Kept after they are
+    // queued, so that a Chunk discarded before it could be saved gets them
+    // back when it is created again, even from neighbors that won't be
+    // decorated again.
+    std::unordered_map<int64_t, std::array<std::vector<PendingWrite>, 9>> m_spills;
+    // Records the m_spilled of a Chunk that was just decorated in m_spills,
+    // and queues each on its neighbor unless that is already meshing
+    void handOnSpills(Chunk *chunk);
+    // Forgets what the Chunk at (x, z) spilled into its neighbors, since it
+    // will spill the same blocks when it is decorated again
+    void forgetSpillsFrom(int x, int z);
+    ChunkLoadStats m_loadStats;
+
+    static const int UPLOAD_HISTORY = 120;
+    // Meshed Chunks taken from VBOdataBuffer but not yet uploaded, because
+    // the frame's upload budget ran out
+    std::vector<Chunk*> m_pendingUploads;
+    // How much of a frame updateTerrian() may spend uploading meshes.
+    // Zero or less means no limit.
+    float m_uploadBudgetMs;
+    long long m_uploadBudgetBytes;
+    std::array<float, UPLOAD_HISTORY> m_uploadHistory;
+    unsigned int m_uploadFrame;
+
+    // Zones out of range, most recently left first. Once there are more
+    // than LEFT_ZONE_CAPACITY the oldest are unloaded, so a player who
+    // turns back finds the last few zones still there.
+    std::list<int64_t> m_leftZones;
+    std::unordered_map<int64_t, std::list<int64_t>::iterator> m_leftZoneIndex;
+    // Zones are unloaded farthest first while residentBytes is above this.
+    // Zero means no limit.
+    size_t m_memoryBudget;
+
+    // Whether m_scheduler can cancel the jobs of the zone's in-flight
+    // Chunks: none has started, and no job on their neighbors, which read
+    // their edges and queue decorations on them, is queued or running
+    bool canUnloadZone(int64_t zone) const;
+    // Cancels the jobs of the zone's in-flight Chunks, including parked
+    // ones, saves its Chunks if they've changed, then deletes them and
+    // forgets the zone was generated. Returns false, changing nothing, if
+    // canUnloadZone() no longer holds.
+    bool unloadZone(int64_t zone);
+    // Unloads the zones that are more than loadRadius + 1 zones from p,
+    // as the LRU and the memory budget require
+    void unloadDistantZones(glm::vec3 p, int loadRadius);
 
     bool hasNewChunkAt(int x, int z) const;
 
+    static const int LEFT_ZONE_CAPACITY = 32;
+    static const size_t DEFAULT_MEMORY_BUDGET = size_t(256) << 20;
+    static constexpr float DEFAULT_UPLOAD_BUDGET_MS = 2.f;
+    static const long long DEFAULT_UPLOAD_BUDGET_BYTES = 4 << 20;
+
+    const ChunkLoadStats& loadStats() const;
+    // Limits the time and bytes updateTerrian() spends uploading meshes
+    // each frame, nearest Chunks first. The rest wait for later frames.
+    // Either limit can be turned off by passing 0.
+    void setUploadBudget(float ms, long long bytes);
+    float uploadBudgetMs() const;
+    long long uploadBudgetBytes() const;
+    // Switches fillColumn() between interpolating m_climate and evaluating
+    // every noise field per column, to compare the two
+    void setClimateCaching(bool enabled);
+    bool climateCaching() const;
+    // Switches fillColumn() between 3D caves, tunnels and overhangs
+    // interpolated from a CaveDensity lattice, and the older caves between
+    // two 2D height fields. Call before the first updateTerrian(); Chunks
+    // already generated keep their caves.
+    void setDensityCaves(bool enabled);
+    bool densityCaves() const;
+    // Generates terrain from the noise seed from now on. Call before the
+    // first updateTerrian(); Chunks already generated keep the old seed's
+    // terrain. The seed is shared by every Terrain, see setNoiseSeed().
+    void setSeed(uint32_t seed);
+    uint32_t seed() const;
+    // Saves Chunks into storage and loads them back from it from now on,
+    // and switches to the seed the world was generated from, or records
+    // seed() for a new world. Call before the first updateTerrian().
+    void setWorldStorage(uPtr<WorldStorage> storage);
+    // nullptr if there is none
+    const WorldStorage* worldStorage() const;
+    // Caps the memory held by loaded Chunks, or lifts the cap if bytes is 0.
+    // The zones around the player are never unloaded, whatever the cap.
+    void setMemoryBudget(size_t bytes);
+    size_t memoryBudget() const;
+    // Switches m_scheduler between nearest-and-in-view first and
+    // first-come, first-served, to compare the two
+    void setPrioritizedLoading(bool prioritized);
+    bool prioritizedLoading() const;
+
     uPtr<Chunk>& getNewChunkAt(int x, int z);
     void setNewBlockAt(int x, int y, int z, enum::BlockType t);
 
+    // Memory report: bytes used by the block storage of every
+    // Chunk that has been sent to the GPU, and how many there are
+    size_t blockMemoryUsage() const;
+    int chunkCount() const;
+    // Mesh size and rebuild time averaged over every Chunk
+    MeshStats averageMeshStats() const;
+
+    // Rebuilds the mesh of every Chunk, e.g. after switching
+    // ChunkSection::setGreedyMeshing
+    void remeshAll();
+
+    // Finishes the generation and meshing in flight, stops the worker
+    // threads and saves every changed Chunk
     void end();
 
 };
@@ -0,0 +1,103 @@
+#include "workerpool.h"
+#include <algorithm>
+
+// Which of its pool's workers the calling thread is, or -1
+static thread_local int t_workerIndex = -1;
+static thread_local const WorkerPool *t_workerPool = nullptr;
+
+WorkerPool::WorkerPool(int threadCount)
+    : m_workers(), m_nextWorker(0), m_queued(0), m_pending(0), m_stopping(false),
+      m_mutex(), m_wake(), m_idle()
+{
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+    for (int i = 0; i < threadCount; i++) {
+        m_workers.push_back(mkU<Worker>());
+    }
+    // Only start them once every queue exists, since they steal
+    for (int i = 0; i < threadCount; i++) {
+        m_workers[i]->thread = std::thread(&WorkerPool::run, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (uPtr<Worker> &worker : m_workers) {
+        worker->thread.join();
+    }
+}
+
+void WorkerPool::submit(Task task) {
+    m_pending++;
+    int count = static_cast<int>(m_workers.size());
+    int first = t_workerPool == this ? t_workerIndex
+                                     : static_cast<int>(m_nextWorker++ % count);
+    bool queued = false;
+    for (int i = 0; i < count && !queued; i++) {
+        queued = m_workers[(first + i) % count]->queue.tryPush(std::move(task));
+    }
+    if (!queued) {
+        task();
+        finish();
+        return;
+    }
+    m_queued++;
+    {
+        // Taking the lock orders this with a worker deciding to sleep, so
+        // the notify can't slip in between its check and its wait
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_wake.notify_one();
+}
+
+bool WorkerPool::runOne(int index) {
+    int count = static_cast<int>(m_workers.size());
+    Task task;
+    for (int i = 0; i < count; i++) {
+        if (m_workers[(index + i) % count]->queue.tryPop(task)) {
+            m_queued--;
+            task();
+            finish();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::finish() {
+    if (--m_pending == 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.notify_all();
+    }
+}
+
+void WorkerPool::run(int index) {
+    t_workerIndex = index;
+    t_workerPool = this;
+    for (;;) {
+        if (runOne(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_queued > 0 || m_stopping; });
+        // A task still running may submit more, but those go to its own
+        // thread's queue and that thread picks them up
+        if (m_stopping && m_queued <= 0) {
+            return;
+        }
+    }
+}
+
+void WorkerPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_pending == 0; });
+}
+
+int WorkerPool::threadCount() const {
+    return static_cast<int>(m_workers.size());
+}
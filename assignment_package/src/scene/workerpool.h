@@ -0,0 +1,63 @@
+#pragma once
+#include "mpmcqueue.h"
+#include "smartpointerhelp.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that run submitted tasks, one queue per thread.
+// A thread works through its own queue first and then steals from the
+// others', so a burst of tasks submitted from one place still spreads
+// over every thread. Tasks submitted by a task go to its own thread's
+// queue. Threads with nothing to do sleep until the next submit().
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+private:
+    // Tasks each thread's queue can hold. Should they all fill up,
+    // submit() runs the task itself.
+    static const std::size_t QUEUE_CAPACITY = 1024;
+
+    struct Worker
+    {
+        MPMCQueue<Task> queue;
+        std::thread thread;
+
+        Worker() : queue(QUEUE_CAPACITY), thread() {}
+    };
+
+    std::vector<uPtr<Worker>> m_workers;
+    // Where submit() puts a task from outside the pool, round robin
+    std::atomic<unsigned int> m_nextWorker;
+    // Tasks sitting in the queues
+    std::atomic<int> m_queued;
+    // Tasks submitted but not finished
+    std::atomic<int> m_pending;
+    bool m_stopping;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+
+    void run(int index);
+    // Pops a task from worker index's queue, or steals one from another
+    // queue, and runs it. Returns false if every queue was empty.
+    bool runOne(int index);
+    void finish();
+
+public:
+    // Starts threadCount threads; 0 means one per hardware thread, less
+    // one for the main thread
+    explicit WorkerPool(int threadCount = 0);
+    // Runs every task that was submitted, then stops the threads
+    ~WorkerPool();
+
+    void submit(Task task);
+    // Blocks until every submitted task has finished
+    void waitIdle();
+    int threadCount() const;
+};
@@ -0,0 +1,176 @@
+#include "worldstorage.h"
+#include "chunk.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+WorldStorage::WorldStorage(const std::string &directory)
+    : m_directory(directory), m_mappedReads(true), m_mutex(), m_regions(), m_pending(), m_stats(), m_io(1)
+{
+    std::filesystem::create_directories(m_directory);
+}
+
+WorldStorage::~WorldStorage() {
+    flush();
+}
+
+int64_t WorldStorage::key(int x, int z) {
+    return (static_cast<int64_t>(x) << 32) | static_cast<uint32_t>(z);
+}
+
+RegionFile* WorldStorage::region(int cx, int cz, bool create) {
+    int rx = cx >> RegionFile::SIZE_LOG2;
+    int rz = cz >> RegionFile::SIZE_LOG2;
+    auto it = m_regions.find(key(rx, rz));
+    if (it != m_regions.end()) {
+        return it->second.get();
+    }
+    std::string path = m_directory + "/r." + std::to_string(rx) + "." + std::to_string(rz) + ".mmr";
+    if (!create && !std::filesystem::exists(path)) {
+        return nullptr;
+    }
+    uPtr<RegionFile> &file = m_regions[key(rx, rz)];
+    file = mkU<RegionFile>(path);
+    return file.get();
+}
+
+bool WorldStorage::load(Chunk *chunk) {
+    auto start = std::chrono::steady_clock::now();
+    int cx = chunk->m_pos.x >> 4;
+    int cz = chunk->m_pos.y >> 4;
+
+    std::shared_ptr<const std::vector<uint8_t>> pending;
+    RegionFile *file = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pending.find(key(cx, cz));
+        if (it != m_pending.end()) {
+            pending = it->second;
+        } else {
+            try {
+                file = region(cx, cz, false);
+            } catch (const std::runtime_error &e) {
+                std::cout << e.what() << std::endl;
+            }
+            if (file == nullptr) {
+                return false;
+            }
+        }
+    }
+
+    bool decoded;
+    if (pending != nullptr) {
+        decoded = chunk->decodeBlocks(pending->data(), pending->size());
+    } else {
+        // Outside m_mutex, so loads on different threads decode at once
+        if (!file->contains(cx, cz)) {
+            return false;
+        }
+        decoded = file->read(cx, cz, m_mappedReads, [chunk](const uint8_t *data, size_t size) {
+            return chunk->decodeBlocks(data, size);
+        });
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!decoded) {
+        std::cout << "Saved chunk at " << chunk->m_pos.x << ", " << chunk->m_pos.y
+                  << " is corrupt, generating it again" << std::endl;
+        m_stats.corruptChunks++;
+        return false;
+    }
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_stats.chunksLoaded++;
+    m_stats.averageLoadMs += (ms - m_stats.averageLoadMs) / m_stats.chunksLoaded;
+    return true;
+}
+
+void WorldStorage::save(Chunk *chunk) {
+    int cx = chunk->m_pos.x >> 4;
+    int cz = chunk->m_pos.y >> 4;
+    auto payload = std::make_shared<std::vector<uint8_t>>();
+    chunk->encodeBlocks(*payload);
+    chunk->markSaved();
+    std::shared_ptr<const std::vector<uint8_t>> shared = payload;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending[key(cx, cz)] = shared;
+    }
+
+    m_io.submit([this, cx, cz, shared] {
+        RegionFile *file = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            try {
+                file = region(cx, cz, true);
+            } catch (const std::runtime_error &e) {
+                std::cout << e.what() << std::endl;
+            }
+        }
+        if (file != nullptr) {
+            file->write(cx, cz, *shared);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (file != nullptr) {
+            m_stats.chunksSaved++;
+            m_stats.bytesWritten += static_cast<long long>(shared->size());
+        }
+        // A newer save of the same Chunk may have been queued meanwhile
+        auto it = m_pending.find(key(cx, cz));
+        if (it != m_pending.end() && it->second == shared) {
+            m_pending.erase(it);
+        }
+    });
+}
+
+void WorldStorage::prefetch(int cx, int cz) {
+    if (!m_mappedReads) {
+        return;
+    }
+    m_io.submit([this, cx, cz] {
+        RegionFile *file = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            try {
+                file = region(cx, cz, false);
+            } catch (const std::runtime_error &e) {
+                std::cout << e.what() << std::endl;
+            }
+        }
+        if (file != nullptr) {
+            file->prefetch(cx, cz);
+        }
+    });
+}
+
+void WorldStorage::flush() {
+    m_io.waitIdle();
+}
+
+uint32_t WorldStorage::seed(uint32_t newWorldSeed) {
+    std::string path = m_directory + "/seed";
+    std::ifstream in(path);
+    uint32_t seed = 0;
+    if (in >> seed) {
+        return seed;
+    }
+    std::ofstream out(path, std::ios::trunc);
+    if (!(out << newWorldSeed << std::endl)) {
+        throw std::runtime_error("Couldn't write the world seed to " + path);
+    }
+    return newWorldSeed;
+}
+
+void WorldStorage::setMappedReads(bool mapped) {
+    m_mappedReads = mapped;
+}
+
+bool WorldStorage::mappedReads() const {
+    return m_mappedReads;
+}
+
+WorldStorage::Stats WorldStorage::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
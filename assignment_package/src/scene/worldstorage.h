@@ -0,0 +1,80 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "regionfile.h"
+#include "workerpool.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Chunk;
+
+// Saves Chunks' blocks to, and loads them from, a directory of RegionFiles.
+// Saving encodes the blocks on the calling thread, which is cheap, and
+// leaves the disk writes to a thread of its own. load() may be called from
+// any thread and sees Chunks whose save hasn't reached the disk yet.
+// Loads decode straight out of the region files' mappings unless
+// setMappedReads(false) switches them to buffered reads.
+class WorldStorage
+{
+public:
+    struct Stats
+    {
+        int chunksLoaded = 0;
+        int chunksSaved = 0;
+        // Payloads that failed their checksum or didn't decode, and were
+        // generated again instead
+        int corruptChunks = 0;
+        long long bytesWritten = 0;
+        // Reading and decoding one saved Chunk
+        float averageLoadMs = 0.f;
+    };
+
+private:
+    std::string m_directory;
+    std::atomic<bool> m_mappedReads;
+    // Guards everything below
+    mutable std::mutex m_mutex;
+    // Open region files by region coordinates, see key()
+    std::unordered_map<int64_t, uPtr<RegionFile>> m_regions;
+    // Payloads passed to save() that haven't been written yet, by Chunk
+    std::unordered_map<int64_t, std::shared_ptr<const std::vector<uint8_t>>> m_pending;
+    Stats m_stats;
+    // Writes the payloads in m_pending, one at a time, and issues
+    // prefetches. Declared last so that it finishes them before anything
+    // else is destroyed.
+    WorkerPool m_io;
+
+    static int64_t key(int x, int z);
+    // The region file holding Chunk (cx, cz), opened on first use. If it
+    // doesn't exist, creates it when create is set and otherwise returns
+    // nullptr. Throws std::runtime_error if it can't be opened.
+    // Call with m_mutex held. The RegionFile lives as long as this does.
+    RegionFile* region(int cx, int cz, bool create);
+
+public:
+    // Creates directory if it doesn't exist
+    explicit WorldStorage(const std::string &directory);
+    ~WorldStorage();
+
+    // Replaces chunk's blocks with the saved ones, if there are any.
+    // Returns false if the Chunk was never saved or its data is corrupt.
+    bool load(Chunk *chunk);
+    // Queues chunk's blocks to be written, and marks it saved
+    void save(Chunk *chunk);
+    // Asks the OS to start reading Chunk (cx, cz) from disk, so that a
+    // load() soon after doesn't wait for it. Returns immediately.
+    void prefetch(int cx, int cz);
+    // Waits until every queued save is on disk
+    void flush();
+    // The noise seed the world was generated from. A new world, or one
+    // saved before seeds were recorded, records newWorldSeed. Throws
+    // std::runtime_error if the seed can't be recorded.
+    uint32_t seed(uint32_t newWorldSeed);
+    void setMappedReads(bool mapped);
+    bool mappedReads() const;
+
+    Stats stats() const;
+};
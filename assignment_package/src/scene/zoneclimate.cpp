@@ -0,0 +1,109 @@
+#include "zoneclimate.h"
+
+// p rotated by angle * pi radians, so each field samples the noise along
+// different axes
+static glm::vec2 rotated(float x, float z, double angle) {
+    float pi = 3.14159f;
+    return glm::vec2(x * cos(pi * angle) - sin(pi * angle) * z,
+                     x * sin(pi * angle) + cos(pi * angle) * z);
+}
+
+ClimateSample ClimateSample::at(float x, float z) {
+    ClimateSample sample;
+    sample.moisture = 0.5 * (::moisture(rotated(x, z, 0.25) / 1000.f) + 1);
+    sample.temperature = 0.5 * (::moisture(rotated(x, z, 0.45) / 1000.f) + 1);
+    sample.dunes = desert(rotated(x, z, 0.33), 300, 128);
+    sample.plateau = desert(rotated(x, z, 0.20), 200, 148);
+    sample.hills = desert(rotated(x, z, 0.20), 100, 148);
+    sample.meadow = grassland(glm::vec2(x, z), 50, 148);
+    return sample;
+}
+
+ClimateSample ClimateSample::mix(const ClimateSample &a, const ClimateSample &b, float t) {
+    return ClimateSample{glm::mix(a.moisture, b.moisture, t),
+                         glm::mix(a.temperature, b.temperature, t),
+                         glm::mix(a.dunes, b.dunes, t),
+                         glm::mix(a.plateau, b.plateau, t),
+                         glm::mix(a.hills, b.hills, t),
+                         glm::mix(a.meadow, b.meadow, t)};
+}
+
+ClimateColumn::ClimateColumn(const ClimateSample &sample)
+    : biome(ISLAND), height(0)
+{
+    float s = glm::smoothstep(0.4f, 0.75f, sample.moisture);
+    float t = glm::smoothstep(0.4f, 0.75f, sample.temperature);
+    float low = glm::mix(sample.dunes, sample.plateau, s);
+    float high = glm::mix(sample.hills, sample.meadow, s);
+    height = static_cast<int>(glm::mix(low, high, t));
+
+    float threshold = 0.6;
+    if (s < threshold && t > threshold) {
+        biome = GRASSLAND;
+    } else if (s > threshold && t < threshold) {
+        biome = SANDLAND;
+    } else if (s > threshold && t > threshold) {
+        biome = MOUNTAIN;
+    }
+}
+
+ZoneClimate::ZoneClimate(glm::ivec2 origin)
+    : m_origin(origin), m_lattice()
+{
+    for (int i = 0; i < POINTS; i++) {
+        for (int j = 0; j < POINTS; j++) {
+            m_lattice[i + POINTS * j] = ClimateSample::at(origin.x + SPACING * i, origin.y + SPACING * j);
+        }
+    }
+}
+
+ClimateSample ZoneClimate::sample(int x, int z) const {
+    int lx = x - m_origin.x;
+    int lz = z - m_origin.y;
+    int i = lx / SPACING;
+    int j = lz / SPACING;
+    float fx = (lx % SPACING) / static_cast<float>(SPACING);
+    float fz = (lz % SPACING) / static_cast<float>(SPACING);
+    const ClimateSample *row = &m_lattice[i + POINTS * j];
+    return ClimateSample::mix(ClimateSample::mix(row[0], row[1], fx),
+                              ClimateSample::mix(row[POINTS], row[POINTS + 1], fx), fz);
+}
+
+ZoneClimateCache::ZoneClimateCache()
+    : m_mutex(), m_zones()
+{}
+
+int64_t ZoneClimateCache::key(glm::ivec2 zone) {
+    return (static_cast<int64_t>(zone.x) << 32) | static_cast<uint32_t>(zone.y);
+}
+
+std::shared_ptr<const ZoneClimate> ZoneClimateCache::get(int x, int z) {
+    glm::ivec2 zone(64 * static_cast<int>(glm::floor(x / 64.f)), 64 * static_cast<int>(glm::floor(z / 64.f)));
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_zones.find(key(zone));
+        if (it != m_zones.end()) {
+            return it->second;
+        }
+    }
+    // Computed without the lock so other zones aren't held up. Two workers
+    // may both compute the same zone; the first one stored wins.
+    auto climate = std::make_shared<const ZoneClimate>(zone);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_zones.emplace(key(zone), climate).first->second;
+}
+
+void ZoneClimateCache::erase(glm::ivec2 zone) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_zones.erase(key(zone));
+}
+
+void ZoneClimateCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_zones.clear();
+}
+
+int ZoneClimateCache::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<int>(m_zones.size());
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "glm_includes.h"
+#include "biomes.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// The low-frequency noise Terrain::fillColumn() builds a column from.
+// The cave ceiling isn't here: caveCeil() jumps between two fields, which
+// interpolating would smear by up to 20 blocks.
+struct ClimateSample
+{
+    // Both in [0, 1]
+    float moisture;
+    float temperature;
+    // The four height fields the biomes blend between
+    float dunes;
+    float plateau;
+    float hills;
+    float meadow;
+
+    // Evaluates every field at world column (x, z)
+    static ClimateSample at(float x, float z);
+    static ClimateSample mix(const ClimateSample &a, const ClimateSample &b, float t);
+};
+
+// What fillColumn() needs from a ClimateSample
+struct ClimateColumn
+{
+    BiomeType biome;
+    int height;
+
+    explicit ClimateColumn(const ClimateSample &sample);
+};
+
+// One terrain generation zone's ClimateSamples, evaluated every SPACING
+// blocks and bilinearly interpolated in between, so the noise is evaluated
+// 81 times per zone instead of once per column. Against evaluating every
+// column, surface heights are off by up to 6 blocks (1 on average) and
+// about 1 column in 2000 changes biome.
+class ZoneClimate
+{
+public:
+    static const int SPACING = 8;
+    static const int POINTS = 64 / SPACING + 1;
+
+private:
+    // Lower-left corner of the zone in world space
+    glm::ivec2 m_origin;
+    std::array<ClimateSample, POINTS * POINTS> m_lattice;
+
+public:
+    explicit ZoneClimate(glm::ivec2 origin);
+
+    // World column (x, z), which must lie in the zone
+    ClimateSample sample(int x, int z) const;
+};
+
+// The ZoneClimate of every zone being generated, shared by the workers
+// filling its Chunks. Thread safe.
+class ZoneClimateCache
+{
+private:
+    mutable std::mutex m_mutex;
+    std::unordered_map<int64_t, std::shared_ptr<const ZoneClimate>> m_zones;
+
+    static int64_t key(glm::ivec2 zone);
+
+public:
+    ZoneClimateCache();
+
+    // The ZoneClimate of the zone containing world column (x, z),
+    // computed on first use
+    std::shared_ptr<const ZoneClimate> get(int x, int z);
+    // Forgets the zone whose lower-left corner is zone
+    void erase(glm::ivec2 zone);
+    // Forgets every zone, e.g. because the noise seed changed
+    void clear();
+    int size() const;
+};
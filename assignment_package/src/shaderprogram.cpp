@@ -1,4 +1,5 @@
 #include "shaderprogram.h"
+#include "scene/chunksection.h"
 #include <QFile>
 #include <QStringBuilder>
 #include <QTextStream>
@@ -9,9 +10,9 @@
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
-      attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1),
+      attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1), attrPacked(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1),
-      unif_sampler2D(-1), unif_time(-1), unif_textureBetter(-1),
+      unif_sampler2D(-1), unif_time(-1), unif_chunkOrigins(-1), unif_textureBetter(-1),
       unif_camPos(-1), unif_postType(-1),
       /* TEST!!! */
       unif_dimensions(-1), unif_eye(-1),
@@ -73,6 +74,7 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     if(attrCol == -1) attrCol = context->glGetAttribLocation(prog, "vs_ColInstanced");
     attrPosOffset = context->glGetAttribLocation(prog, "vs_OffsetInstanced");
     attrUV = context->glGetAttribLocation(prog, "vs_UV");
+    attrPacked = context->glGetAttribLocation(prog, "vs_Packed");
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
@@ -82,6 +84,7 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unif_normSampler2D = context->glGetUniformLocation(prog, "u_normTexture");
     unif_textureBetter = context->glGetUniformLocation(prog, "u_textureBetter");
     unif_time = context->glGetUniformLocation(prog, "u_Time");
+    unif_chunkOrigins = context->glGetUniformLocation(prog, "u_ChunkOrigins");
 
     unif_camPos = context->glGetUniformLocation(prog, "u_CamPos");
 
@@ -391,11 +394,18 @@ void ShaderProgram::drawInterleave(Drawable &d, int texture_slot = 0)
                                        (void*)(sizeof(glm::vec4) * 2));
     }
 
+    // Packed Chunk vertices are read as two unsigned ints and unpacked in the shader
+    if (attrPacked != -1 && d.bindInterleave()){
+        context->glEnableVertexAttribArray(attrPacked);
+        context->glVertexAttribIPointer(attrPacked, 2, GL_UNSIGNED_INT, 0, (void*)0);
+    }
+
     d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+    context->glDrawElementsBaseVertex(d.drawMode(), d.elemCount(), d.idxType(), 0, d.baseVertex());
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
     if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
+    if (attrPacked != -1) context->glDisableVertexAttribArray(attrPacked);
     context->printGLErrorLog();
 }
 
@@ -434,12 +444,64 @@ void ShaderProgram::drawInterleave_transparent(Drawable &d, int texture_slot = 0
                                        (void*)(sizeof(glm::vec4) * 2));
     }
 
+    // Packed Chunk vertices are read as two unsigned ints and unpacked in the shader
+    if (attrPacked != -1 && d.bindInterleave_transparent()){
+        context->glEnableVertexAttribArray(attrPacked);
+        context->glVertexAttribIPointer(attrPacked, 2, GL_UNSIGNED_INT, 0, (void*)0);
+    }
+
     d.bindIdx_transparent();
-    context->glDrawElements(d.drawMode(), d.elemCount_transparent(), GL_UNSIGNED_INT, 0);
+    context->glDrawElementsBaseVertex(d.drawMode(), d.elemCount_transparent(), d.idxType(), 0,
+                                      d.baseVertex_transparent());
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
     if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
+    if (attrPacked != -1) context->glDisableVertexAttribArray(attrPacked);
+    context->printGLErrorLog();
+}
+
+int ShaderProgram::drawChunkBatch(int page, const ChunkDrawBatch &batch, bool transparent, int first, int count)
+{
+    useMe();
+
+    if (first < 0 || count < 0 || first + count > static_cast<int>(batch.counts.size())){
+        throw std::out_of_range("Attempting to draw sections " + std::to_string(first) + " to " +
+                                std::to_string(first + count) + " of a batch of " +
+                                std::to_string(batch.counts.size()) + "!");
+    }
+    if (unif_sampler2D != -1){
+        context->glUniform1i(unif_sampler2D, 0);
+    }
+    if (unif_textureBetter != -1){
+        context->glUniform1i(unif_textureBetter, 2);
+    }
+    if (unif_normSampler2D != -1 && !transparent){
+        context->glUniform1i(unif_normSampler2D, 1);
+    }
+
+    MeshArena &arena = ChunkSection::meshArena();
+    // The origins go in texture slot 3, after the three terrain textures
+    if (unif_chunkOrigins != -1){
+        context->glActiveTexture(GL_TEXTURE3);
+        arena.bindOrigins(context, page);
+        context->glUniform1i(unif_chunkOrigins, 3);
+        context->glActiveTexture(GL_TEXTURE0);
+    }
+
+    arena.bindPage(context, page);
+    if (attrPacked != -1){
+        context->glEnableVertexAttribArray(attrPacked);
+        context->glVertexAttribIPointer(attrPacked, 2, GL_UNSIGNED_INT, 0, (void*)0);
+    }
+
+    ChunkSection::quadIndices().bind(context);
+    int calls = context->multiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data() + first,
+                                                     ChunkSection::quadIndices().type(),
+                                                     batch.offsets.data() + first, count,
+                                                     batch.baseVertices.data() + first);
+    if (attrPacked != -1) context->glDisableVertexAttribArray(attrPacked);
     context->printGLErrorLog();
+    return calls;
 }
 
 void ShaderProgram::drawQuad(Drawable &d){
@@ -7,6 +7,8 @@
 
 #include "drawable.h"
 
+struct ChunkDrawBatch;
+
 
 class ShaderProgram
 {
@@ -20,6 +22,7 @@ public:
     int attrCol; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrPosOffset; // A handle for a vec3 used only in the instanced rendering shader
     int attrUV;
+    int attrPacked; // A handle for the "in" uvec2 holding a whole packed Chunk vertex (see PackedVertex)
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
@@ -29,6 +32,7 @@ public:
     int unif_normSampler2D;
     int unif_textureBetter;
     int unif_time;
+    int unif_chunkOrigins; // A handle for the isamplerBuffer of Chunk origins in the MeshArena page being drawn
 
     int unif_camPos;
 
@@ -74,6 +78,11 @@ public:
 
     void drawInterleave_transparent(Drawable &d, int texture_slot);
 
+    // Draws count of the sections in batch, starting at first, all of
+    // which live in the given ChunkSection::meshArena() page.
+    // Returns the number of GL draw calls it took.
+    int drawChunkBatch(int page, const ChunkDrawBatch &batch, bool transparent, int first, int count);
+
     void setPostType(int type);
 
 
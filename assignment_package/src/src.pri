@@ -22,7 +22,22 @@ SOURCES += \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
-    $$PWD/framebuffer.cpp
+    $$PWD/scene/palettedsection.cpp \
+    $$PWD/scene/chunksection.cpp \
+    $$PWD/scene/quadindexbuffer.cpp \
+    $$PWD/scene/meshbuffer.cpp \
+    $$PWD/scene/mesharena.cpp \
+    $$PWD/scene/frustum.cpp \
+    $$PWD/scene/chunkgrid.cpp \
+    $$PWD/scene/workerpool.cpp \
+    $$PWD/scene/chunkscheduler.cpp \
+    $$PWD/scene/regionfile.cpp \
+    $$PWD/scene/worldstorage.cpp \
+    $$PWD/scene/zoneclimate.cpp \
+    $$PWD/scene/noisebatch.cpp \
+    $$PWD/scene/cavedensity.cpp \
+    $$PWD/framebuffer.cpp \
+    $$PWD/benchmark.cpp
 
 HEADERS += \
     $$PWD/inventory.h \
@@ -46,4 +61,20 @@ HEADERS += \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
-    $$PWD/framebuffer.h
+    $$PWD/scene/palettedsection.h \
+    $$PWD/scene/chunksection.h \
+    $$PWD/scene/quadindexbuffer.h \
+    $$PWD/scene/meshbuffer.h \
+    $$PWD/scene/mesharena.h \
+    $$PWD/scene/frustum.h \
+    $$PWD/scene/chunkgrid.h \
+    $$PWD/scene/mpmcqueue.h \
+    $$PWD/scene/workerpool.h \
+    $$PWD/scene/chunkscheduler.h \
+    $$PWD/scene/regionfile.h \
+    $$PWD/scene/worldstorage.h \
+    $$PWD/scene/zoneclimate.h \
+    $$PWD/scene/noisebatch.h \
+    $$PWD/scene/cavedensity.h \
+    $$PWD/framebuffer.h \
+    $$PWD/benchmark.h